@@ -0,0 +1,515 @@
+// Replays traces through the simulator and reports how fast it was and whether its results changed.
+//
+//   HorizonBench generate <trace> [--preset skirmish|midgame|lategame] [--frames N] [--seed N]
+//   HorizonBench replay <trace> [--threads N] [--tolerance X]
+//   HorizonBench check <iterations> [--seed N] [--tolerance X]
+//
+// Traces can be recorded from a real game with Simulator::startTrace, generate writes a deterministic synthetic game instead.
+// Replay compares every result against the one recorded in the trace and exits with 1 if any differ by more than the tolerance.
+// Check runs the enemy kernel this build was compiled with against its scalar version on random stores and exits with 1 if they disagree.
+
+#include "Core.h"
+#include "Kernel.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Horizon;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    double microseconds(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::micro>(end - start).count();
+    }
+
+    // Rough stats of a few common units, speeds are pixels per frame and damage per frame
+    struct Archetype {
+        int type;
+        int hitPoints;
+        int shields;
+        int width;
+        int size;
+        float groundRange;
+        float airRange;
+        float speed;
+        float groundStrength;
+        float airStrength;
+        float groundDPS;
+        float airDPS;
+        bool flyer;
+        bool worker;
+        bool siege;
+    };
+
+    const Archetype Archetypes[] = {
+        { 0,   40,  0, 17, 0, 128.0f, 128.0f, 4.0f,  2.5f, 2.5f, 0.40f, 0.40f, false, false, false },  // Marine
+        { 65, 100, 60, 23, 0,  15.0f,   0.0f, 4.0f,  5.0f, 0.0f, 0.73f, 0.00f, false, false, false },  // Zealot
+        { 66, 100, 80, 32, 2, 128.0f, 128.0f, 5.0f,  6.0f, 6.0f, 0.67f, 0.67f, false, false, false },  // Dragoon
+        { 37,  35,  0, 16, 0,  15.0f,   0.0f, 5.6f,  2.0f, 0.0f, 0.63f, 0.00f, false, false, false },  // Zergling
+        { 38,  80,  0, 21, 1, 128.0f, 128.0f, 3.7f,  4.0f, 4.0f, 0.67f, 0.67f, false, false, false },  // Hydralisk
+        { 43, 120,  0, 22, 0,  96.0f,  96.0f, 6.7f,  4.5f, 4.5f, 0.30f, 0.30f, true,  false, false },  // Mutalisk
+        { 30, 150,  0, 32, 2, 384.0f,   0.0f, 0.0f, 12.0f, 0.0f, 1.13f, 0.00f, false, false, true  },  // Sieged tank
+        { 7,   60,  0, 23, 0,  15.0f,   0.0f, 4.9f,  0.0f, 0.0f, 0.00f, 0.00f, false, true,  false },  // Worker
+    };
+
+    // Army compositions of each preset: how many units each side starts with and keeps reinforcing up to
+    struct Preset {
+        const char* name;
+        int army;
+        int workers;
+        int frames;
+    };
+
+    const Preset Presets[] = {
+        { "skirmish",  12,  0,  2000 },
+        { "midgame",   60, 20,  4000 },
+        { "lategame", 140, 60,  6000 },
+    };
+
+    struct Unit {
+        UnitData data;
+        float x;
+        float y;
+        float health;
+        int target = -1;        // Index into the other side
+    };
+
+    // A simple fight between two armies that march at each other, shoot the closest enemy and are reinforced from their base
+    class Skirmish {
+        Simulator simulator;
+        std::mt19937 rng;
+        std::vector<Unit> sides[2];
+        int nextId = 0;
+        int mapSize = 128;
+
+        // mt19937 is the same everywhere, unlike the standard distributions
+        int roll(int n) { return int(rng() % uint32_t(n)); }
+
+        void spawn(int side, bool worker) {
+            const auto &a = worker ? Archetypes[7] : Archetypes[roll(7)];
+            Unit u;
+            u.data.id = nextId++;
+            u.data.type = a.type;
+            u.data.mine = side == 0;
+            u.data.width = a.width;
+            u.data.tileWidth = 1;
+            u.data.tileHeight = 1;
+            u.data.hitPoints = a.hitPoints;
+            u.data.shields = a.shields;
+            u.data.maxHitPoints = a.hitPoints;
+            u.data.maxShields = a.shields;
+            u.data.groundRange = a.groundRange;
+            u.data.airRange = a.airRange;
+            u.data.speed = a.speed;
+            u.data.maxGroundStrength = a.groundStrength;
+            u.data.maxAirStrength = a.airStrength;
+            u.data.groundDPS = a.groundDPS;
+            u.data.airDPS = a.airDPS;
+            u.data.size = a.size;
+            u.data.flyer = a.flyer;
+            u.data.worker = a.worker;
+            u.data.siege = a.siege;
+            u.health = float(a.hitPoints + a.shields);
+
+            const auto base = side == 0 ? 16 * 32 : (mapSize - 16) * 32;
+            u.x = float(base + roll(320) - 160);
+            u.y = float(base + roll(320) - 160);
+            sides[side].push_back(u);
+        }
+
+        void retarget(int side) {
+            auto &enemies = sides[1 - side];
+            for (auto &u : sides[side]) {
+                u.target = -1;
+                auto best = 0.0f;
+                for (int i = 0; i < int(enemies.size()); i++) {
+                    const auto d = std::hypot(enemies[i].x - u.x, enemies[i].y - u.y);
+                    if (u.target < 0 || d < best) {
+                        u.target = i;
+                        best = d;
+                    }
+                }
+            }
+        }
+
+        void step(int side) {
+            auto &enemies = sides[1 - side];
+            for (auto &u : sides[side]) {
+                if (u.target < 0 || u.target >= int(enemies.size()))
+                    continue;
+
+                auto &t = enemies[u.target];
+                const auto d = std::hypot(t.x - u.x, t.y - u.y);
+                const auto range = (t.data.flyer ? u.data.airRange : u.data.groundRange) + float(u.data.width + t.data.width) / 2.0f;
+                if (d > range && d > 0.0f) {
+                    const auto move = std::min(u.data.speed, d - range);
+                    u.x += (t.x - u.x) / d * move;
+                    u.y += (t.y - u.y) / d * move;
+                }
+                else
+                    t.health -= t.data.flyer ? u.data.airDPS : u.data.groundDPS;
+            }
+        }
+
+        // An enemy changes sides, like a Dark Archon's Mind Control, and waits for the next pass to pick a target
+        void convert() {
+            auto &enemies = sides[1];
+            if (enemies.empty())
+                return;
+
+            const auto i = roll(int(enemies.size()));
+            auto u = enemies[i];
+            enemies[i] = enemies.back();
+            enemies.pop_back();
+            u.data.mine = true;
+            u.target = -1;
+            sides[0].push_back(u);
+        }
+
+        void sync(Unit& u, const std::vector<Unit>& enemies) {
+            const auto total = std::max(0, int(std::ceil(u.health)));
+            u.data.shields = std::min(total, u.data.maxShields);
+            u.data.hitPoints = total - u.data.shields;
+            u.data.x = std::clamp(int(u.x), 0, mapSize * 32 - 1);
+            u.data.y = std::clamp(int(u.y), 0, mapSize * 32 - 1);
+            u.data.tileX = u.data.x / 32;
+            u.data.tileY = u.data.y / 32;
+            u.data.target = u.target >= 0 && u.target < int(enemies.size()) ? enemies[u.target].data.id : -1;
+        }
+
+    public:
+        explicit Skirmish(int seed) : rng(uint32_t(seed)) {}
+
+        bool run(const std::string& path, const Preset& preset, int frames) {
+            TileGrid heights, walkable;
+            heights.resize(mapSize, mapSize);
+            walkable.resize(mapSize, mapSize);
+            for (int y = 0; y < mapSize; y++) {
+                for (int x = 0; x < mapSize; x++) {
+                    heights.set(x, y, uint8_t((x + y) / 64));
+                    walkable.set(x, y, !(x % 24 == 12 && y % 16 < 10));
+                }
+            }
+            simulator.setMap(heights, walkable);
+            if (!simulator.startTrace(path))
+                return false;
+
+            for (int side = 0; side < 2; side++) {
+                for (int i = 0; i < preset.army; i++)
+                    spawn(side, false);
+                for (int i = 0; i < preset.workers; i++)
+                    spawn(side, true);
+            }
+
+            for (int frame = 1; frame <= frames; frame++) {
+                simulator.setFrame(frame);
+                step(0);
+                step(1);
+
+                // The dead are removed and replaced a few at a time, like larva and eggs constantly coming and going
+                for (int side = 0; side < 2; side++) {
+                    auto &units = sides[side];
+                    for (int i = 0; i < int(units.size()); i++) {
+                        if (units[i].health <= 0.0f) {
+                            simulator.removeUnit(units[i].data.id);
+                            units[i] = units.back();
+                            units.pop_back();
+                            i--;
+                        }
+                    }
+                    if (frame % 12 == 0 && int(units.size()) < preset.army + preset.workers)
+                        spawn(side, roll(4) == 0);
+                }
+                if (frame % 240 == 120)
+                    convert();
+
+                // Indices into the other side go stale as units die, a unit without a valid target just waits for the next pass
+                if (frame % 24 == 1) {
+                    retarget(0);
+                    retarget(1);
+                }
+
+                for (int side = 0; side < 2; side++) {
+                    for (auto &u : sides[side]) {
+                        sync(u, sides[1 - side]);
+                        simulator.updateUnit(u.data);
+                    }
+                }
+
+                // Enemies far from all of our units drop out of vision
+                if (frame % 24 == 12) {
+                    for (auto &e : sides[1]) {
+                        auto seen = false;
+                        for (auto &u : sides[0])
+                            seen = seen || std::hypot(e.x - u.x, e.y - u.y) < 800.0f;
+                        simulator.setExists(e.data.id, seen);
+                    }
+                }
+
+                simulator.getSimValues(5.0f, frame % 4 == 0 ? Engine::Lanchester : Engine::Linear);
+                if (frame % 8 == 0 && !sides[0].empty()) {
+                    const auto &u = sides[0][roll(int(sides[0].size()))];
+                    simulator.getSimValue(u.data.id, 2.0f);
+                    simulator.getSimValue(u.data.id, 10.0f, Engine::Lanchester);
+                }
+            }
+            simulator.stopTrace();
+            return true;
+        }
+    };
+
+    struct Latencies {
+        std::vector<double> samples;
+
+        void add(double us) { samples.push_back(us); }
+
+        void print(const char* name) {
+            if (samples.empty())
+                return;
+            std::sort(samples.begin(), samples.end());
+            const auto at = [&](double p) { return samples[std::min(samples.size() - 1, size_t(p * double(samples.size())))]; };
+            printf("  %-14s calls %8zu  p50 %9.1fus  p90 %9.1fus  p99 %9.1fus  max %9.1fus\n", name, samples.size(), at(0.5), at(0.9), at(0.99), samples.back());
+        }
+    };
+
+    // Relative difference, with 1 as the smallest scale so values near 0 don't blow up
+    float difference(const HorizonOutput& a, const HorizonOutput& b) {
+        auto worst = a.shouldSynch != b.shouldSynch ? 1.0f : 0.0f;
+        for (auto value : { &HorizonOutput::attackAirAsAir, &HorizonOutput::attackAirAsGround, &HorizonOutput::attackGroundAsAir, &HorizonOutput::attackGroundasGround })
+            worst = std::max(worst, std::abs(a.*value - b.*value) / std::max(1.0f, std::abs(b.*value)));
+        return worst;
+    }
+
+    int replay(const std::string& path, int threads, float tolerance) {
+        Trace::Reader reader;
+        if (!reader.open(path)) {
+            fprintf(stderr, "Can't read trace %s\n", path.c_str());
+            return 2;
+        }
+
+        Simulator simulator;
+        simulator.setThreads(threads);
+
+        Trace::Event event;
+        Latencies updates, queries, curves, batches, frames;
+        auto frameTime = 0.0, totalTime = 0.0;
+        auto frameCount = 0, simulations = 0, fields = 0, compared = 0, differing = 0, missing = 0;
+        auto worst = 0.0f;
+
+        const auto check = [&](int id, const HorizonOutput& replayed, const HorizonOutput& recorded) {
+            compared++;
+            const auto diff = difference(replayed, recorded);
+            worst = std::max(worst, diff);
+            if (diff > tolerance && differing++ < 10)
+                printf("  unit %d differs by %g: %g %g %g %g, recorded %g %g %g %g\n", id, diff,
+                    replayed.attackAirAsAir, replayed.attackAirAsGround, replayed.attackGroundAsAir, replayed.attackGroundasGround,
+                    recorded.attackAirAsAir, recorded.attackAirAsGround, recorded.attackGroundAsAir, recorded.attackGroundasGround);
+        };
+
+        const auto endFrame = [&]() {
+            if (frameCount > 0)
+                frames.add(frameTime);
+            simulations += simulator.getUpdateCounters().simulations;
+            fields += simulator.getUpdateCounters().distanceFields;
+            frameTime = 0.0;
+        };
+
+        while (reader.next(event)) {
+            const auto start = Clock::now();
+            switch (event.kind) {
+            case Trace::Kind::Map:
+                simulator.setMap(event.heights, event.walkable);
+                break;
+            case Trace::Kind::Frame:
+                endFrame();
+                frameCount++;
+                simulator.setFrame(event.frame);
+                break;
+            case Trace::Kind::Update:
+                simulator.updateUnit(event.unit);
+                updates.add(microseconds(start, Clock::now()));
+                break;
+            case Trace::Kind::Remove:
+                simulator.removeUnit(event.id);
+                break;
+            case Trace::Kind::Exists:
+                simulator.setExists(event.id, event.exists);
+                break;
+            case Trace::Kind::Query: {
+                const auto output = simulator.getSimValue(event.id, event.simTime, event.engine);
+                queries.add(microseconds(start, Clock::now()));
+                check(event.id, output, event.output);
+                break;
+            }
+            case Trace::Kind::Curve: {
+                const auto &curve = simulator.getSimCurve(event.id, event.simTimes);
+                curves.add(microseconds(start, Clock::now()));
+                missing += int(std::max(curve.size(), event.curve.size()) - std::min(curve.size(), event.curve.size()));
+                for (size_t i = 0; i < std::min(curve.size(), event.curve.size()); i++)
+                    check(event.id, curve[i], event.curve[i]);
+                break;
+            }
+            case Trace::Kind::Values: {
+                const auto &outputs = simulator.getSimValues(event.simTime, event.engine);
+                batches.add(microseconds(start, Clock::now()));
+
+                // Both are in the simulator's own order, which only depends on the calls made
+                if (outputs.size() != event.outputs.size())
+                    missing += int(std::max(outputs.size(), event.outputs.size()) - std::min(outputs.size(), event.outputs.size()));
+                for (size_t i = 0; i < std::min(outputs.size(), event.outputs.size()); i++) {
+                    if (outputs[i].first != event.outputs[i].first)
+                        missing++;
+                    else
+                        check(outputs[i].first, outputs[i].second, event.outputs[i].second);
+                }
+                break;
+            }
+            case Trace::Kind::ClusterRadius:
+                simulator.setClusterRadius(event.clusterRadius);
+                break;
+            case Trace::Kind::CacheTolerance:
+                simulator.setCacheTolerance(event.cacheTolerance);
+                break;
+            case Trace::Kind::Schedule:
+                simulator.setSchedule(event.schedule);
+                break;
+            case Trace::Kind::DistanceBudget:
+                simulator.setDistanceBudget(event.distanceBudget);
+                break;
+            }
+            const auto elapsed = microseconds(start, Clock::now());
+            frameTime += elapsed;
+            totalTime += elapsed;
+        }
+        endFrame();
+        if (reader.truncated())
+            printf("  trace is cut short, replayed up to the last complete event\n");
+
+        const auto seconds = std::max(1e-9, totalTime / 1e6);
+        printf("%s\n", path.c_str());
+        printf("  frames %d, %.2fs in Horizon, %.0f frames/s, %.0f updates/s, %.0f simulations/s, %d distance fields built\n",
+            frameCount, seconds, frameCount / seconds, updates.samples.size() / seconds, simulations / seconds, fields);
+        updates.print("updateUnit");
+        queries.print("getSimValue");
+        curves.print("getSimCurve");
+        batches.print("getSimValues");
+        frames.print("frame");
+        printf("  compared %d outputs, %d differ by more than %g, %d missing, largest difference %g\n", compared, differing, tolerance, missing, worst);
+        return differing > 0 || missing > 0 || reader.truncated() ? 1 : 0;
+    }
+
+    // Random stores with every case the kernels branch on, queried over ranges that start and end part way through a lane
+    int check(int iterations, int seed, float tolerance) {
+        std::mt19937 random{ uint32_t(seed) };
+        const auto roll = [&](float lo, float hi) { return lo + (hi - lo) * float(random() % 65536u) / 65536.0f; };
+        const auto chance = [&](float p) { return roll(0.0f, 1.0f) < p; };
+
+        UnitStore store;
+        auto compared = 0, differing = 0;
+        auto worst = 0.0f;
+
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            const auto count = 1 + int(random() % 200);
+            store.reset(count);
+            for (int i = 0; i < count; i++) {
+                store.x[i] = roll(0.0f, 2048.0f);
+                store.y[i] = roll(0.0f, 2048.0f);
+                store.groundRange[i] = chance(0.2f) ? 0.0f : roll(15.0f, 384.0f);
+                store.airRange[i] = chance(0.4f) ? 0.0f : roll(15.0f, 256.0f);
+                store.speed[i] = chance(0.15f) ? 0.0f : roll(40.0f, 200.0f);
+                store.groundStrength[i] = roll(0.0f, 12.0f);
+                store.airStrength[i] = roll(0.0f, 12.0f);
+                store.width[i] = roll(8.0f, 64.0f);
+                store.height[i] = float(random() % 3);
+                store.flyer[i] = chance(0.2f) ? 1.0f : 0.0f;
+                store.siege[i] = chance(0.1f) ? 1.0f : 0.0f;
+                store.active[i] = chance(0.9f) ? 1.0f : 0.0f;
+            }
+
+            Kernel::EnemyQuery q;
+            q.unitX = roll(0.0f, 2048.0f);
+            q.unitY = roll(0.0f, 2048.0f);
+            q.engageX = q.unitX + roll(-256.0f, 256.0f);
+            q.engageY = q.unitY + roll(-256.0f, 256.0f);
+            q.width = roll(8.0f, 64.0f);
+            q.speed = roll(40.0f, 200.0f);
+            q.height = float(random() % 3);
+            q.simTime = roll(0.5f, 8.0f);
+            q.flyer = chance(0.3f);
+
+            const auto begin = int(random() % uint32_t(count));
+            const auto end = begin + int(random() % uint32_t(count - begin + 1));
+            auto grdSimd = 0.0f, airSimd = 0.0f, grdScalar = 0.0f, airScalar = 0.0f;
+            Kernel::simEnemies(store, begin, end, q, grdSimd, airSimd);
+            Kernel::simEnemiesScalar(store, begin, end, q, grdScalar, airScalar);
+
+            for (auto [simd, scalar] : { std::pair(grdSimd, grdScalar), std::pair(airSimd, airScalar) }) {
+                compared++;
+                const auto diff = std::abs(simd - scalar) / std::max(1.0f, std::abs(scalar));
+                worst = std::max(worst, diff);
+                if (diff > tolerance && differing++ < 10)
+                    printf("  iteration %d, units %d to %d of %d: %s gives %g, scalar gives %g\n", iteration, begin, end, count, Kernel::Name, simd, scalar);
+            }
+        }
+
+        printf("%s kernel against scalar: compared %d values, %d differ by more than %g, largest difference %g\n", Kernel::Name, compared, differing, tolerance, worst);
+        return differing > 0 ? 1 : 0;
+    }
+
+    const char* option(int argc, char** argv, const char* name, const char* fallback) {
+        for (int i = 3; i + 1 < argc; i++) {
+            if (std::strcmp(argv[i], name) == 0)
+                return argv[i + 1];
+        }
+        return fallback;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s generate <trace> [--preset skirmish|midgame|lategame] [--frames N] [--seed N]\n", argv[0]);
+        fprintf(stderr, "       %s replay <trace> [--threads N] [--tolerance X]\n", argv[0]);
+        fprintf(stderr, "       %s check <iterations> [--seed N] [--tolerance X]\n", argv[0]);
+        return 2;
+    }
+
+    const std::string command = argv[1];
+    const std::string path = argv[2];
+
+    if (command == "generate") {
+        const std::string name = option(argc, argv, "--preset", "midgame");
+        auto preset = std::find_if(std::begin(Presets), std::end(Presets), [&](auto &p) { return name == p.name; });
+        if (preset == std::end(Presets)) {
+            fprintf(stderr, "Unknown preset %s\n", name.c_str());
+            return 2;
+        }
+
+        const auto frames = std::atoi(option(argc, argv, "--frames", std::to_string(preset->frames).c_str()));
+        const auto seed = std::atoi(option(argc, argv, "--seed", "1"));
+        Skirmish skirmish(seed);
+        if (!skirmish.run(path, *preset, frames)) {
+            fprintf(stderr, "Can't write trace %s\n", path.c_str());
+            return 2;
+        }
+        printf("Wrote %d frames of %s to %s\n", frames, preset->name, path.c_str());
+        return 0;
+    }
+
+    if (command == "replay")
+        return replay(path, std::atoi(option(argc, argv, "--threads", "1")), float(std::atof(option(argc, argv, "--tolerance", "0.0001"))));
+
+    if (command == "check")
+        return check(std::atoi(path.c_str()), std::atoi(option(argc, argv, "--seed", "1")), float(std::atof(option(argc, argv, "--tolerance", "0.0001"))));
+
+    fprintf(stderr, "Unknown command %s\n", command.c_str());
+    return 2;
+}
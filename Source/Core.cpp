@@ -0,0 +1,938 @@
+#include "Core.h"
+#include "Lanchester.h"
+#include "Profile.h"
+#include "Trace.h"
+#include <chrono>
+#include <cmath>
+
+namespace Horizon {
+
+    namespace {
+
+        // Runs the body over each row of cells that a circle around the position touches, or every cell if it covers the map
+        template <typename World, typename Body>
+        void visitCells(const World& world, const std::vector<int>& cells, float x, float y, float radius, Body body) {
+            auto x0 = 0, y0 = 0;
+            auto x1 = world.gridWidth - 1, y1 = world.gridHeight - 1;
+            if (radius < float(SpatialHash::CellSize * std::max(world.gridWidth, world.gridHeight))) {
+                x0 = std::clamp(int(x - radius) / SpatialHash::CellSize, 0, x1);
+                y0 = std::clamp(int(y - radius) / SpatialHash::CellSize, 0, y1);
+                x1 = std::clamp(int(x + radius) / SpatialHash::CellSize, 0, x1);
+                y1 = std::clamp(int(y + radius) / SpatialHash::CellSize, 0, y1);
+            }
+            for (int row = y0; row <= y1; row++)
+                body(cells[row * world.gridWidth + x0], cells[row * world.gridWidth + x1 + 1]);
+        }
+
+        // Nothing further away than it can travel in the simulation, plus its range, can reach the engage position
+        template <typename World, typename Body>
+        void visitEnemies(const World& world, const Kernel::EnemyQuery& enemy, Body body) {
+            const auto range = enemy.flyer ? world.enemyAirRange : world.enemyGroundRange;
+            const auto reach = enemy.simTime * std::max(world.enemySpeed, enemy.speed) + range + (world.enemyWidth + enemy.width) / 2.0f;
+            visitCells(world, world.enemyCells, enemy.engageX, enemy.engageY, reach, body);
+        }
+
+        // Allies only count if they can reach the target in time
+        template <typename World, typename Body>
+        void visitAllies(const World& world, const Kernel::AllyQuery& ally, Body body) {
+            visitCells(world, world.allyCells, ally.targetX, ally.targetY, ally.simTime * world.allySpeed, body);
+        }
+
+        HorizonOutput makeOutput(float enemyGrdSim, float enemyAirSim, float myGrdSim, float myAirSim, bool sync) {
+            HorizonOutput newOutput;
+            newOutput.attackAirAsAir =          enemyAirSim > 0.0f ? myAirSim / enemyAirSim : 10.0f;
+            newOutput.attackAirAsGround =       enemyGrdSim > 0.0f ? myAirSim / enemyGrdSim : 10.0f;
+            newOutput.attackGroundAsAir =       enemyAirSim > 0.0f ? myGrdSim / enemyAirSim : 10.0f;
+            newOutput.attackGroundasGround =    enemyGrdSim > 0.0f ? myGrdSim / enemyGrdSim : 10.0f;
+            newOutput.shouldSynch =             sync;
+            return newOutput;
+        }
+
+        // The walk never beats the straight line, which covers the tiles it cuts corners of
+        float walkDistance(const DistanceField& field, int x1, int y1, int x2, int y2) {
+            const auto ground = field.getDistance(x1 / 32, y1 / 32);
+            return ground < 0.0f ? ground : std::max(ground, float(std::hypot(double(x1 - x2), double(y1 - y2))));
+        }
+    }
+
+    Simulator::Record* Simulator::UnitList::find(int id) {
+        const auto slot = ids.find(id);
+        return slot >= 0 ? &records[slot] : nullptr;
+    }
+
+    int Simulator::UnitList::insert(int id) {
+        if (const auto slot = ids.find(id); slot >= 0)
+            return slot;
+
+        const auto slot = records.acquire().slot;
+        if (slot >= 0)
+            ids.insert(id, slot);
+        return slot;
+    }
+
+    void Simulator::UnitList::erase(int id) {
+        const auto slot = ids.find(id);
+        if (slot < 0)
+            return;
+
+        records.release(slot);
+        store.clear(slot);
+        grid.remove(slot);
+        ids.erase(id);
+    }
+
+    Simulator::Record* Simulator::getTarget(const Record& record) {
+        auto &list = record.targetMine ? myUnits : enemyUnits;
+        return list.records.get(record.targetHandle);
+    }
+
+    // Buildings on the ground block the tiles under them, distance fields are updated in place as they come and go
+    void Simulator::occupyTiles(int tileX, int tileY, int width, int height, int adj) {
+        for (int x = tileX; x < tileX + width; x++) {
+            for (int y = tileY; y < tileY + height; y++) {
+                if (!buildingTiles.valid(x, y))
+                    continue;
+
+                const auto count = buildingTiles.get(x, y) + adj;
+                buildingTiles.set(x, y, uint8_t(std::max(0, count)));
+
+                const auto open = terrainWalkable.get(x, y) && count <= 0;
+                if (open != (walkable.get(x, y) != 0)) {
+                    walkable.set(x, y, open);
+                    open ? distances.unblock(walkable, x, y) : distances.block(walkable, x, y);
+                }
+            }
+        }
+    }
+
+    // Moves the tiles a record blocks to where the unit is now, so liftoffs, landings and morphs into or out of buildings free what they blocked before
+    void Simulator::placeBuilding(Record& record) {
+        auto &u = record.data;
+        const auto blocking = u.building && !u.flyer && !walkable.empty();
+        const auto width = blocking ? u.tileWidth : 0;
+        const auto height = blocking ? u.tileHeight : 0;
+        const auto x = blocking ? u.tileX : 0;
+        const auto y = blocking ? u.tileY : 0;
+        if (x == record.blockX && y == record.blockY && width == record.blockWidth && height == record.blockHeight)
+            return;
+
+        occupyTiles(record.blockX, record.blockY, record.blockWidth, record.blockHeight, -1);
+        occupyTiles(x, y, width, height, 1);
+        record.blockX = x;
+        record.blockY = y;
+        record.blockWidth = width;
+        record.blockHeight = height;
+    }
+
+    bool Simulator::canAddToSim(const Record& record) {
+        auto &u = record.data;
+        if (u.worker
+            || (u.exists && (u.stasised || u.morphing || !u.completed))
+            || (record.visAirStrength <= 0.0 && record.visGroundStrength <= 0.0))
+            return false;
+        return true;
+    }
+
+    void Simulator::writeStore(UnitStore& store, int slot, const Record& record) {
+        auto &unit = record.data;
+        store.x[slot] = float(unit.x);
+        store.y[slot] = float(unit.y);
+        store.groundRange[slot] = unit.groundRange;
+        store.airRange[slot] = unit.airRange;
+        store.speed[slot] = 24.0f * unit.speed;
+        store.groundStrength[slot] = record.visGroundStrength;
+        store.airStrength[slot] = record.visAirStrength;
+        store.width[slot] = float(unit.width);
+        store.height[slot] = float(groundHeights.get(unit.tileX, unit.tileY));
+        store.flyer[slot] = unit.flyer ? 1.0f : 0.0f;
+        store.siege[slot] = unit.siege ? 1.0f : 0.0f;
+        store.hitPoints[slot] = float(unit.hitPoints + unit.shields);
+        store.groundDPS[slot] = 24.0f * unit.groundDPS;
+        store.airDPS[slot] = 24.0f * unit.airDPS;
+        store.sizeClass[slot] = float(unit.size);
+
+        if (auto target = getTarget(record)) {
+            const auto widths = float(unit.width + target->data.width) / 2.0f;
+            const auto distance = std::max(0.0f, record.engageDist - widths);
+            store.engageTime[slot] = distance / store.speed[slot];
+            store.stranded[slot] = (unit.speed <= 0.0 && distance > 0.0f) ? 1.0f : 0.0f;
+            store.highGround[slot] = (!unit.flyer && groundHeight(record.engageX, record.engageY) > groundHeight(target->data.x, target->data.y)) ? 1.0f : 0.0f;
+        }
+    }
+
+    // Refreshes which units pass the simulation filter, this is the only per-query work that isn't done in updateUnit
+    void Simulator::prepare() {
+        for (auto slot : enemyUnits.records.slots())
+            enemyUnits.store.active[slot] = canAddToSim(enemyUnits.records[slot]) ? 1.0f : 0.0f;
+        for (auto slot : myUnits.records.slots())
+            myUnits.store.active[slot] = canAddToSim(myUnits.records[slot]) && getTarget(myUnits.records[slot]) ? 1.0f : 0.0f;
+    }
+
+    // Copies the active units of a list into the store cell by cell
+    void Simulator::layout(const UnitList& list, UnitStore& store, std::vector<int>& cells, std::vector<float>& strengths) {
+        auto count = 0;
+        for (auto slot : list.records.slots())
+            count += list.store.active[slot] > 0.0f;
+
+        store.reset(count);
+        cells.resize(list.grid.getWidth() * list.grid.getHeight() + 1);
+        strengths.assign(list.grid.getWidth() * list.grid.getHeight(), 0.0f);
+
+        auto next = 0;
+        for (int y = 0; y < list.grid.getHeight(); y++) {
+            for (int x = 0; x < list.grid.getWidth(); x++) {
+                const auto cell = y * list.grid.getWidth() + x;
+                cells[cell] = next;
+                for (auto slot : list.grid.getCell(x, y)) {
+                    if (list.store.active[slot] > 0.0f) {
+                        store.copy(list.store, slot, next++);
+                        strengths[cell] += list.store.groundStrength[slot] + list.store.airStrength[slot];
+                    }
+                }
+            }
+        }
+        cells.back() = next;
+    }
+
+    void Simulator::takeSnapshot() {
+        layout(enemyUnits, snapshot.enemies, snapshot.enemyCells, snapshot.enemyStrength);
+        layout(myUnits, snapshot.allies, snapshot.allyCells, snapshot.allyStrength);
+        snapshot.gridWidth = enemyUnits.grid.getWidth();
+        snapshot.gridHeight = enemyUnits.grid.getHeight();
+
+        snapshot.enemySpeed = 0.0f;
+        snapshot.enemyGroundRange = 0.0f;
+        snapshot.enemyAirRange = 0.0f;
+        snapshot.enemyWidth = 0.0f;
+        for (int i = 0; i < snapshot.enemies.used; i++) {
+            snapshot.enemySpeed = std::max(snapshot.enemySpeed, snapshot.enemies.speed[i]);
+            snapshot.enemyGroundRange = std::max(snapshot.enemyGroundRange, snapshot.enemies.groundRange[i]);
+            snapshot.enemyAirRange = std::max(snapshot.enemyAirRange, snapshot.enemies.airRange[i]);
+            snapshot.enemyWidth = std::max(snapshot.enemyWidth, snapshot.enemies.width[i]);
+        }
+
+        snapshot.allySpeed = 0.0f;
+        for (int i = 0; i < snapshot.allies.used; i++)
+            snapshot.allySpeed = std::max(snapshot.allySpeed, snapshot.allies.speed[i]);
+    }
+
+    Simulator::SimQuery Simulator::makeQuery(const Record& record, float simTime, Engine engine) {
+        SimQuery query;
+        query.engine = engine;
+        auto &unit = record.data;
+        auto &target = getTarget(record)->data;
+        const auto unitToEngage = float(std::max(0.0, double(record.engageDist) / (24.0 * unit.speed)));
+        const auto simulationTime = unitToEngage + simTime;
+
+        query.enemy.engageX = float(record.engageX);
+        query.enemy.engageY = float(record.engageY);
+        query.enemy.unitX = float(unit.x);
+        query.enemy.unitY = float(unit.y);
+        query.enemy.width = float(unit.width);
+        query.enemy.speed = 24.0f * unit.speed;
+        query.enemy.height = float(groundHeight(record.engageX, record.engageY));
+        query.enemy.simTime = simulationTime;
+        query.enemy.flyer = unit.flyer;
+
+        query.ally.targetX = float(target.x);
+        query.ally.targetY = float(target.y);
+        query.ally.simTime = simulationTime;
+        query.ally.flyer = unit.flyer;
+        return query;
+    }
+
+    // Only reads the snapshot it's given, so any number of these can run at once
+    HorizonOutput Simulator::simulate(const Snapshot& world, const SimQuery& query) {
+        HORIZON_TIMER(Simulate);
+        float enemyGrdSim = 0.0f;
+        float enemyAirSim = 0.0f;
+        float myGrdSim = 0.0f;
+        float myAirSim = 0.0f;
+        auto sync = false;
+
+        if (query.engine == Engine::Lanchester) {
+            thread_local std::vector<Lanchester::Fighter> enemies, allies;
+            enemies.clear();
+            allies.clear();
+            {
+                HORIZON_TIMER(SimEnemies);
+                visitEnemies(world, query.enemy, [&](int begin, int end) {
+                    Lanchester::gatherEnemies(world.enemies, begin, end, query.enemy, enemies);
+                });
+            }
+            {
+                HORIZON_TIMER(SimAllies);
+                visitAllies(world, query.ally, [&](int begin, int end) {
+                    sync = Lanchester::gatherAllies(world.allies, begin, end, query.ally, allies) || sync;
+                });
+            }
+            Lanchester::simulate(enemies, allies, query.enemy.simTime, enemyGrdSim, enemyAirSim, myGrdSim, myAirSim);
+            HORIZON_FLUSH();
+            return makeOutput(enemyGrdSim, enemyAirSim, myGrdSim, myAirSim, sync);
+        }
+
+        {
+            HORIZON_TIMER(SimEnemies);
+            visitEnemies(world, query.enemy, [&](int begin, int end) {
+                Kernel::simEnemies(world.enemies, begin, end, query.enemy, enemyGrdSim, enemyAirSim);
+            });
+        }
+        {
+            HORIZON_TIMER(SimAllies);
+            visitAllies(world, query.ally, [&](int begin, int end) {
+                sync = Kernel::simAllies(world.allies, begin, end, query.ally, myGrdSim, myAirSim) || sync;
+            });
+        }
+        HORIZON_FLUSH();
+        return makeOutput(enemyGrdSim, enemyAirSim, myGrdSim, myAirSim, sync);
+    }
+
+    // Strength in the cells up to this many cells away from a position
+    float Simulator::nearbyStrength(const std::vector<float>& strengths, float x, float y, int reach) const {
+        const auto cellX = std::clamp(int(x) / SpatialHash::CellSize, 0, snapshot.gridWidth - 1);
+        const auto cellY = std::clamp(int(y) / SpatialHash::CellSize, 0, snapshot.gridHeight - 1);
+        auto strength = 0.0f;
+        for (int cy = std::max(0, cellY - reach); cy <= std::min(snapshot.gridHeight - 1, cellY + reach); cy++) {
+            for (int cx = std::max(0, cellX - reach); cx <= std::min(snapshot.gridWidth - 1, cellX + reach); cx++)
+                strength += strengths[cy * snapshot.gridWidth + cx];
+        }
+        return strength;
+    }
+
+    Simulator::Signature Simulator::sign(const SimQuery& query) const {
+        Signature signature;
+        signature.engageX = query.enemy.engageX;
+        signature.engageY = query.enemy.engageY;
+        signature.simTime = query.enemy.simTime;
+        signature.engine = query.engine;
+        signature.enemyStrength = nearbyStrength(snapshot.enemyStrength, query.enemy.engageX, query.enemy.engageY, 1);
+        signature.allyStrength = nearbyStrength(snapshot.allyStrength, query.ally.targetX, query.ally.targetY, 1);
+        signature.frame = counters.frame;
+        return signature;
+    }
+
+    bool Simulator::reusable(const Record& record, const Signature& signature) const {
+        auto &cached = record.signature;
+        const auto age = signature.frame - cached.frame;
+        const auto close = [&](float a, float b) { return std::abs(a - b) <= cacheTolerance.strength * std::max(a, b); };
+
+        return cached.frame >= 0
+            && cached.engine == signature.engine
+            && age >= 0 && age < cacheTolerance.frames
+            && std::hypot(signature.engageX - cached.engageX, signature.engageY - cached.engageY) <= cacheTolerance.distance
+            && std::abs(signature.simTime - cached.simTime) <= cacheTolerance.simTime
+            && close(signature.enemyStrength, cached.enemyStrength)
+            && close(signature.allyStrength, cached.allyStrength);
+    }
+
+    Simulator::Simulator() = default;
+
+    Simulator::~Simulator() = default;
+
+    void Simulator::setMap(const TileGrid& heights, const TileGrid& walkableTiles) {
+        if (trace)
+            trace->map(heights, walkableTiles);
+
+        groundHeights = heights;
+        terrainWalkable = walkableTiles;
+        walkable = walkableTiles;
+        buildingTiles.resize(walkable.getWidth(), walkable.getHeight());
+        distances.clear();
+        dirty = true;
+
+        for (auto list : { &myUnits, &enemyUnits }) {
+            list->grid.resize(walkable.getWidth() * 32, walkable.getHeight() * 32);
+            for (auto slot : list->records.slots()) {
+                auto &record = list->records[slot];
+                record.blockWidth = 0;
+                record.blockHeight = 0;
+                placeBuilding(record);
+                writeStore(list->store, slot, list->records[slot]);
+                list->grid.insert(slot, list->store.x[slot], list->store.y[slot]);
+            }
+        }
+    }
+
+    void Simulator::setFrame(int frame) {
+        if (counters.frame != frame) {
+            HORIZON_FRAME(frame);
+            if (trace)
+                trace->frame(frame);
+            counters = UpdateCounters();
+            counters.frame = frame;
+            counters.distanceFields = distances.buildPending(walkable, distanceBudget);
+        }
+    }
+
+    int Simulator::updateUnit(const UnitData& unit) {
+        HORIZON_TIMER(UpdateUnit);
+        if (trace)
+            trace->update(unit);
+        auto recomputed = 0;
+
+        // Changed owner, a replay of the update drops it from the old side the same way, so it isn't traced as a removal
+        auto &list = unit.mine ? myUnits : enemyUnits;
+        if ((unit.mine ? enemyUnits : myUnits).find(unit.id))
+            eraseUnit(unit.id);
+
+        const auto added = !list.find(unit.id);
+        const auto slot = list.insert(unit.id);
+        if (slot < 0)
+            return 0;
+
+        auto &record = list.records[slot];
+        const auto previous = record.data;
+        record.data = unit;
+
+        // A new unit, morph or finished upgrade
+        if (added
+            || unit.type != previous.type
+            || unit.width != previous.width
+            || unit.flyer != previous.flyer
+            || unit.siege != previous.siege
+            || unit.speed != previous.speed
+            || unit.groundRange != previous.groundRange
+            || unit.airRange != previous.airRange
+            || unit.groundDPS != previous.groundDPS
+            || unit.airDPS != previous.airDPS
+            || unit.size != previous.size) {
+            recomputed++;
+        }
+        placeBuilding(record);
+
+        // Re-resolve the target if we were given a new one or it was removed
+        auto target = getTarget(record);
+        if (added || unit.target != previous.target || (unit.target >= 0 && !target)) {
+            record.targetHandle = Handle();
+            if (unit.target >= 0) {
+                if (const auto mine = myUnits.ids.find(unit.target); mine >= 0) {
+                    record.targetHandle = myUnits.records.handle(mine);
+                    record.targetMine = true;
+                }
+                else if (const auto enemy = enemyUnits.ids.find(unit.target); enemy >= 0) {
+                    record.targetHandle = enemyUnits.records.handle(enemy);
+                    record.targetMine = false;
+                }
+            }
+            target = getTarget(record);
+            recomputed++;
+        }
+
+        // Took damage, healed, was disabled or its strength changed
+        if (added
+            || unit.hitPoints != previous.hitPoints
+            || unit.shields != previous.shields
+            || unit.disabled != previous.disabled
+            || unit.maxGroundStrength != previous.maxGroundStrength
+            || unit.maxAirStrength != previous.maxAirStrength) {
+            record.percentHealth = float(unit.hitPoints + (unit.shields / 2)) / float(unit.maxHitPoints + (unit.maxShields / 2));
+            record.visGroundStrength = unit.disabled ? 0.0f : record.percentHealth * unit.maxGroundStrength;
+            record.visAirStrength = unit.disabled ? 0.0f : record.percentHealth * unit.maxAirStrength;
+            recomputed++;
+        }
+
+        // Engage position assumes we approach on a linear line to the target, ground units measure how far away it is along cached distance fields
+        // Here is where you can add custom pathfinding to designate where you expect this unit to engage its target
+        const auto targetX = target ? target->data.x : -1;
+        const auto targetY = target ? target->data.y : -1;
+        const auto targetWidth = target ? target->data.width : 0;
+        if (recomputed > 0 || record.groundPending || unit.x != previous.x || unit.y != previous.y || targetX != record.targetX || targetY != record.targetY || targetWidth != record.targetWidth) {
+            record.targetX = targetX;
+            record.targetY = targetY;
+            record.targetWidth = targetWidth;
+            record.engageX = unit.x;
+            record.engageY = unit.y;
+            record.engageDist = 0.0f;
+            record.groundPending = false;
+
+            if (target) {
+                const auto distance = int(std::hypot(double(unit.x - targetX), double(unit.y - targetY)));
+                const auto range = target->data.flyer ? int(unit.airRange) : int(unit.groundRange);
+                const auto leftover = distance - range;
+                if (distance > range) {
+                    record.engageX = unit.x - (unit.x - targetX) * leftover / distance;
+                    record.engageY = unit.y - (unit.y - targetY) * leftover / distance;
+                }
+                record.engageDist = float(std::hypot(double(unit.x - record.engageX), double(unit.y - record.engageY)));
+
+                // A field that isn't cached is built at the start of a later frame rather than in the middle of this one
+                if (!unit.flyer && walkable.valid(unit.x / 32, unit.y / 32) && walkable.valid(targetX / 32, targetY / 32)) {
+                    const auto field = distances.findField(walkable, targetX / 32, targetY / 32);
+                    const auto ground = field ? walkDistance(*field, unit.x, unit.y, targetX, targetY) : -1.0f;
+                    const auto reach = target->data.flyer ? unit.airRange : unit.groundRange;
+                    record.groundPending = !field;
+                    if (ground >= 0.0f)
+                        record.engageDist = std::max(0.0f, ground - reach);
+                }
+            }
+            recomputed++;
+        }
+
+        counters.unitsUpdated++;
+        if (recomputed > 0
+            || unit.exists != previous.exists
+            || unit.stasised != previous.stasised
+            || unit.morphing != previous.morphing
+            || unit.completed != previous.completed)
+            dirty = true;
+        if (recomputed > 0) {
+            counters.unitsRecomputed++;
+            counters.fieldsRecomputed += recomputed;
+            writeStore(list.store, slot, record);
+            list.grid.insert(slot, float(unit.x), float(unit.y));
+        }
+        return recomputed;
+    }
+
+    void Simulator::removeUnit(int id) {
+        if (trace)
+            trace->remove(id);
+        eraseUnit(id);
+    }
+
+    void Simulator::eraseUnit(int id) {
+        for (auto list : { &myUnits, &enemyUnits }) {
+            if (auto record = list->find(id)) {
+                occupyTiles(record->blockX, record->blockY, record->blockWidth, record->blockHeight, -1);
+                list->erase(id);
+                dirty = true;
+            }
+        }
+    }
+
+    void Simulator::setExists(int id, bool exists) {
+        if (trace)
+            trace->exists(id, exists);
+        for (auto list : { &myUnits, &enemyUnits }) {
+            if (auto record = list->find(id); record && record->data.exists != exists) {
+                record->data.exists = exists;
+                dirty = true;
+            }
+        }
+    }
+
+    const Simulator::Record* Simulator::find(int id) {
+        if (auto record = myUnits.find(id))
+            return record;
+        return enemyUnits.find(id);
+    }
+
+    float Simulator::getGroundDistance(int x1, int y1, int x2, int y2) {
+        if (!walkable.valid(x1 / 32, y1 / 32) || !walkable.valid(x2 / 32, y2 / 32))
+            return -1.0f;
+        return walkDistance(distances.getField(walkable, x2 / 32, y2 / 32), x1, y1, x2, y2);
+    }
+
+    // Publishes the results of the background job once it finishes, then starts the next one from the world as it is now with every parameter queried this frame or the last
+    void Simulator::pollAsync(float simTime, Engine engine) {
+        requested[{ simTime, engine }] = counters.frame;
+        if (!job.worker)
+            job.worker = std::make_unique<Worker>();
+        if (job.worker->busy())
+            return;
+
+        if (job.started) {
+            completed.clear();
+            for (int i = 0; i < int(job.ids.size()); i++)
+                completed[job.parameters[job.sets[i]]][job.ids[i]] = job.world.outputs[i];
+            completedFrame = job.frame;
+            job.started = false;
+        }
+
+        refreshSnapshot();
+        job.ids.clear();
+        job.sets.clear();
+        job.parameters.clear();
+        for (auto itr = requested.begin(); itr != requested.end();) {
+            if (itr->second < counters.frame - 1)
+                itr = requested.erase(itr);
+            else
+                job.parameters.push_back((itr++)->first);
+        }
+        snapshot.queries.clear();
+        for (auto slot : myUnits.records.slots()) {
+            auto &record = myUnits.records[slot];
+            if (!record.data.exists || !getTarget(record))
+                continue;
+            for (int set = 0; set < int(job.parameters.size()); set++) {
+                job.ids.push_back(record.data.id);
+                job.sets.push_back(set);
+                snapshot.queries.push_back(makeQuery(record, job.parameters[set].first, job.parameters[set].second));
+            }
+        }
+
+        // The worker owns this copy until it finishes, the next frame builds into the other one
+        std::swap(job.world, snapshot);
+        dirty = true;
+        job.frame = counters.frame;
+        job.started = true;
+        job.worker->run([this] {
+            auto &world = job.world;
+            const auto count = int(world.queries.size());
+            world.outputs.resize(count);
+            const auto body = [&](int begin, int end) {
+                for (int i = begin; i < end; i++)
+                    world.outputs[i] = simulate(world, world.queries[i]);
+            };
+
+            if (threadPool)
+                threadPool->parallelFor(count, 8, body);
+            else
+                body(0, count);
+        });
+    }
+
+    void Simulator::waitAsync() {
+        if (job.worker)
+            job.worker->wait();
+    }
+
+    HorizonOutput Simulator::completedValue(int id, float simTime, Engine engine) const {
+        HorizonOutput output;
+        output.age = -1;
+        auto set = completed.find({ simTime, engine });
+        if (set == completed.end())
+            return output;
+        auto itr = set->second.find(id);
+        if (itr == set->second.end())
+            return output;
+
+        output = itr->second;
+        output.age = counters.frame - completedFrame;
+        return output;
+    }
+
+    HorizonOutput Simulator::getSimValue(int id, float simTime, Engine engine) {
+        HORIZON_TIMER(GetSimValue);
+        const auto output = querySimValue(id, simTime, engine);
+        if (trace)
+            trace->query(id, simTime, engine, output);
+        return output;
+    }
+
+    HorizonOutput Simulator::querySimValue(int id, float simTime, Engine engine) {
+        if (async) {
+            pollAsync(simTime, engine);
+            return completedValue(id, simTime, engine);
+        }
+
+        auto record = myUnits.find(id);
+        if (!record || !getTarget(*record))
+            return HorizonOutput();
+
+        refreshSnapshot();
+        const auto query = makeQuery(*record, simTime, engine);
+        const auto signature = sign(query);
+        if (cacheTolerance.frames > 0) {
+            if (reusable(*record, signature)) {
+                cacheStats.hits++;
+                auto output = record->cached;
+                output.age = counters.frame - record->signature.frame;
+                return output;
+            }
+            cacheStats.misses++;
+        }
+
+        counters.simulations++;
+        record->signature = signature;
+        record->cached = simulate(snapshot, query);
+        return record->cached;
+    }
+
+    // Nothing a snapshot holds changes between updates, so queries in between share one
+    void Simulator::refreshSnapshot() {
+        if (!dirty)
+            return;
+        prepare();
+        takeSnapshot();
+        dirty = false;
+    }
+
+    // Units that fight in the same area against the same kind of targets see nearly the same enemies and allies,
+    // so each group is simulated once from the member closest to the group's center
+    void Simulator::cluster(const std::vector<int>& batch, int begin, int end) {
+        auto &clusterKeys = snapshot.clusterKeys;
+        auto &clusters = snapshot.clusters;
+        clusterKeys.clear();
+        clusters.clear();
+
+        for (int i = begin; i < end; i++) {
+            auto &record = myUnits.records[snapshot.slots[batch[i]]];
+            const auto key = std::make_tuple(int(std::floor(record.engageX / clusterRadius)), int(std::floor(record.engageY / clusterRadius)), record.data.flyer);
+            auto itr = clusterKeys.find(key);
+            if (itr == clusterKeys.end()) {
+                itr = clusterKeys.emplace(key, int(clusters.size())).first;
+                clusters.emplace_back();
+            }
+
+            auto &group = clusters[itr->second];
+            group.engageX += float(record.engageX);
+            group.engageY += float(record.engageY);
+            group.members++;
+            snapshot.indices[batch[i]] = itr->second;
+        }
+
+        for (auto &group : clusters) {
+            group.engageX /= float(group.members);
+            group.engageY /= float(group.members);
+        }
+
+        for (int i = begin; i < end; i++) {
+            auto &record = myUnits.records[snapshot.slots[batch[i]]];
+            auto &group = clusters[snapshot.indices[batch[i]]];
+            const auto dist = float(std::hypot(record.engageX - group.engageX, record.engageY - group.engageY));
+            if (group.representative < 0 || dist < group.closest) {
+                group.representative = batch[i];
+                group.closest = dist;
+            }
+        }
+
+        for (auto &group : clusters)
+            snapshot.queries.push_back(snapshot.requests[group.representative]);
+    }
+
+    // Simulates a range of outputs and keeps each result as the unit's latest
+    void Simulator::simulateBatch(const std::vector<int>& batch, int begin, int end) {
+        snapshot.queries.clear();
+        if (clusterRadius > 0.0f)
+            cluster(batch, begin, end);
+        else {
+            for (int i = begin; i < end; i++) {
+                snapshot.indices[batch[i]] = int(snapshot.queries.size());
+                snapshot.queries.push_back(snapshot.requests[batch[i]]);
+            }
+        }
+
+        const auto count = int(snapshot.queries.size());
+        snapshot.outputs.resize(count);
+        const auto body = [&](int first, int last) {
+            for (int i = first; i < last; i++)
+                snapshot.outputs[i] = simulate(snapshot, snapshot.queries[i]);
+        };
+
+        if (threadPool)
+            threadPool->parallelFor(count, 8, body);
+        else
+            body(0, count);
+
+        for (int i = begin; i < end; i++) {
+            auto &record = myUnits.records[snapshot.slots[batch[i]]];
+            outputs[batch[i]].second = snapshot.outputs[snapshot.indices[batch[i]]];
+            record.signature = snapshot.signatures[batch[i]];
+            record.cached = outputs[batch[i]].second;
+        }
+        counters.simulations += count;
+    }
+
+    const std::vector<HorizonOutput>& Simulator::getSimCurve(int id, const std::vector<float>& simTimes) {
+        HORIZON_TIMER(GetSimCurve);
+        querySimCurve(id, simTimes);
+        if (trace)
+            trace->curve(id, simTimes, curve);
+        return curve;
+    }
+
+    void Simulator::querySimCurve(int id, const std::vector<float>& simTimes) {
+        curve.clear();
+        auto record = myUnits.find(id);
+        if (!record || !getTarget(*record) || simTimes.empty()) {
+            curve.resize(simTimes.size());
+            return;
+        }
+
+        refreshSnapshot();
+
+        // Collect every unit that could matter by the longest horizon once, then each horizon is only a sum over them
+        auto query = makeQuery(*record, 0.0f, Engine::Linear);
+        const auto travel = query.enemy.simTime;
+        const auto longest = travel + *std::max_element(simTimes.begin(), simTimes.end());
+        query.enemy.simTime = longest;
+        query.ally.simTime = longest;
+
+        enemyTerms.clear();
+        allyTerms.clear();
+        visitEnemies(snapshot, query.enemy, [&](int begin, int end) {
+            Kernel::enemyTerms(snapshot.enemies, begin, end, query.enemy, enemyTerms);
+        });
+        visitAllies(snapshot, query.ally, [&](int begin, int end) {
+            Kernel::allyTerms(snapshot.allies, begin, end, query.ally, allyTerms);
+        });
+
+        for (auto simTime : simTimes) {
+            float enemyGrdSim = 0.0f;
+            float enemyAirSim = 0.0f;
+            float myGrdSim = 0.0f;
+            float myAirSim = 0.0f;
+
+            Kernel::sweep(enemyTerms, travel + simTime, enemyGrdSim, enemyAirSim);
+            const auto sync = Kernel::sweep(allyTerms, travel + simTime, myGrdSim, myAirSim);
+            curve.push_back(makeOutput(enemyGrdSim, enemyAirSim, myGrdSim, myAirSim, sync));
+        }
+        counters.simulations++;
+    }
+
+    const std::vector<std::pair<int, HorizonOutput>>& Simulator::getSimValues(float simTime, Engine engine) {
+        HORIZON_TIMER(GetSimValues);
+        querySimValues(simTime, engine);
+        if (trace)
+            trace->values(simTime, engine, outputs);
+        return outputs;
+    }
+
+    void Simulator::querySimValues(float simTime, Engine engine) {
+        const auto start = std::chrono::steady_clock::now();
+        outputs.clear();
+
+        if (async) {
+            pollAsync(simTime, engine);
+            for (auto slot : myUnits.records.slots()) {
+                if (auto &data = myUnits.records[slot].data; data.exists)
+                    outputs.emplace_back(data.id, completedValue(data.id, simTime, engine));
+            }
+            return;
+        }
+
+        refreshSnapshot();
+        snapshot.slots.clear();
+        snapshot.indices.clear();
+        snapshot.signatures.clear();
+        snapshot.requests.clear();
+        snapshot.priority.clear();
+        snapshot.idle.clear();
+
+        const auto caching = cacheTolerance.frames > 0;
+        for (auto slot : myUnits.records.slots()) {
+            auto &record = myUnits.records[slot];
+            const auto id = record.data.id;
+            if (!record.data.exists)
+                continue;
+
+            auto output = HorizonOutput();
+            auto query = SimQuery();
+            auto signature = Signature();
+            if (getTarget(record)) {
+                query = makeQuery(record, simTime, engine);
+                signature = sign(query);
+
+                if (caching && reusable(record, signature)) {
+                    output = record.cached;
+                    output.age = counters.frame - record.signature.frame;
+                    cacheStats.hits++;
+                }
+                else {
+                    cacheStats.misses += caching;
+
+                    // Units that can reach their fight in time or have enemies next to them can't wait, the rest answer with their latest result until their turn.
+                    // A latest result from another engine or simulation time doesn't answer this query, so those can't wait either
+                    const auto travel = query.enemy.simTime - simTime;
+                    const auto threatened = nearbyStrength(snapshot.enemyStrength, float(record.data.x), float(record.data.y), 0) > 0.0f;
+                    const auto answered = record.signature.frame >= 0
+                        && record.signature.engine == engine
+                        && std::abs(record.signature.simTime - query.enemy.simTime) <= cacheTolerance.simTime;
+                    if (schedule.budget <= 0 || travel <= simTime || threatened || !answered)
+                        snapshot.priority.push_back(int(outputs.size()));
+                    else {
+                        output = record.cached;
+                        output.age = std::max(0, counters.frame - record.signature.frame);
+                        if (counters.frame - record.signature.frame >= schedule.idleFrames || counters.frame < record.signature.frame)
+                            snapshot.idle.push_back(int(outputs.size()));
+                    }
+                }
+            }
+            snapshot.slots.push_back(slot);
+            snapshot.indices.push_back(-1);
+            snapshot.signatures.push_back(signature);
+            snapshot.requests.push_back(query);
+            outputs.emplace_back(id, output);
+        }
+
+        simulateBatch(snapshot.priority, 0, int(snapshot.priority.size()));
+
+        // Least recently simulated first, whatever doesn't fit in the budget goes first next frame
+        // At least one chunk runs every frame so idle units still cycle when fights take the whole budget
+        auto &idle = snapshot.idle;
+        std::sort(idle.begin(), idle.end(), [&](int a, int b) {
+            return myUnits.records[snapshot.slots[a]].signature.frame < myUnits.records[snapshot.slots[b]].signature.frame;
+        });
+
+        const auto chunk = 8 * (threadPool ? threadPool->size() : 1);
+        for (int i = 0; i < int(idle.size()); i += chunk) {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            if (i > 0 && elapsed >= schedule.budget) {
+                counters.deferred += int(idle.size()) - i;
+                break;
+            }
+            simulateBatch(idle, i, std::min(int(idle.size()), i + chunk));
+        }
+    }
+
+    void Simulator::setDistanceBudget(int tilesPerFrame) {
+        if (trace)
+            trace->distanceBudget(tilesPerFrame);
+        distanceBudget = tilesPerFrame;
+    }
+
+    void Simulator::setClusterRadius(float radius) {
+        if (trace)
+            trace->clusterRadius(radius);
+        clusterRadius = radius;
+    }
+
+    void Simulator::setCacheTolerance(const CacheTolerance& tolerance) {
+        if (trace)
+            trace->cacheTolerance(tolerance);
+        cacheTolerance = tolerance;
+    }
+
+    void Simulator::setSchedule(const Schedule& newSchedule) {
+        if (trace)
+            trace->schedule(newSchedule);
+        schedule = newSchedule;
+    }
+
+    void Simulator::setAsync(bool enabled) {
+        if (!enabled) {
+            job.worker.reset();
+            job.started = false;
+            requested.clear();
+            completed.clear();
+        }
+        async = enabled;
+    }
+
+    void Simulator::setThreads(int threads) {
+        waitAsync();
+        if (threads <= 1)
+            threadPool.reset();
+        else if (!threadPool || threadPool->size() != threads)
+            threadPool = std::make_unique<ThreadPool>(threads);
+    }
+
+    // The trace starts from the world as it is now, so a replay doesn't need anything recorded before it
+    bool Simulator::startTrace(const std::string& path) {
+        trace = std::make_unique<Trace::Writer>();
+        if (!trace->open(path)) {
+            trace.reset();
+            return false;
+        }
+
+        trace->distanceBudget(distanceBudget);
+        trace->clusterRadius(clusterRadius);
+        trace->cacheTolerance(cacheTolerance);
+        trace->schedule(schedule);
+        if (hasMap())
+            trace->map(groundHeights, terrainWalkable);
+        trace->frame(counters.frame);
+
+        // Enemies first, so our units' targets resolve when they're replayed
+        for (auto list : { &enemyUnits, &myUnits }) {
+            for (auto slot : list->records.slots())
+                trace->update(list->records[slot].data);
+        }
+        return true;
+    }
+
+    void Simulator::stopTrace() {
+        trace.reset();
+    }
+}
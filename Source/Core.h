@@ -0,0 +1,333 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "Distance.h"
+#include "Grid.h"
+#include "Kernel.h"
+#include "Pool.h"
+#include "Spatial.h"
+#include "Store.h"
+#include "ThreadPool.h"
+
+namespace Horizon {
+
+    namespace Trace { class Writer; }
+
+    /// Broodwar never has more units than this at once, each side's records are allocated for it up front.
+    constexpr int MaxUnits = 1700;
+
+    struct HorizonOutput {
+        float attackAirAsAir       = 0.0;
+        float attackAirAsGround    = 0.0;
+        float attackGroundAsAir    = 0.0;
+        float attackGroundasGround = 0.0;
+        bool shouldSynch            = false;
+        int age                     = 0;        // Frames since the world this was simulated from, -1 if async simulation has no result for it yet
+    };
+
+    struct UpdateCounters {
+        int frame                   = 0;
+        int unitsUpdated            = 0;
+        int unitsRecomputed         = 0;
+        int fieldsRecomputed        = 0;
+        int simulations             = 0;
+        int deferred                = 0;        // Idle units whose simulation was left for a later frame
+        int distanceFields          = 0;        // Distance fields finished at the start of the frame
+    };
+
+    /// How a simulation adds up strength.
+    enum class Engine {
+        Linear,                                 // Every unit adds its strength for as long as it's in the fight
+        Lanchester                              // Units stop adding strength as they die, fought out in a fixed number of steps
+    };
+
+    /// Bounds how long getSimValues spends each frame.
+    struct Schedule {
+        int budget                  = 0;        // Microseconds, 0 runs every simulation every frame
+        int idleFrames              = 8;        // Idle units aren't simulated more often than this
+    };
+
+    /// How far a unit's simulation inputs can drift before its last result is recomputed.
+    struct CacheTolerance {
+        int frames              = 0;        // How many frames a result can be reused for, 0 disables the cache
+        float distance          = 8.0f;     // Pixels the engage position can move
+        float simTime           = 0.25f;    // Seconds the simulation time can change, this includes the time to reach the engage position
+        float strength          = 0.05f;    // Fraction the strength near the engage position or the target can change
+    };
+
+    struct CacheStats {
+        int hits                = 0;
+        int misses              = 0;
+    };
+
+    /// Plain description of a unit, this is everything the simulator knows about it.
+    /// Stats already include the owner's upgrades and research.
+    struct UnitData {
+        int id                  = -1;
+        int type                = 0;
+        int target              = -1;       // Id of the unit this unit is fighting, -1 for none
+        bool mine               = false;
+
+        int x                   = 0;        // Position in pixels
+        int y                   = 0;
+        int tileX               = 0;        // Top left tile for buildings
+        int tileY               = 0;
+        int width               = 0;
+        int tileWidth           = 0;
+        int tileHeight          = 0;
+
+        int hitPoints           = 0;
+        int shields             = 0;
+        int maxHitPoints        = 0;
+        int maxShields          = 0;
+
+        float groundRange       = 0.0f;
+        float airRange          = 0.0f;
+        float speed             = 0.0f;     // Pixels per frame
+        float maxGroundStrength = 0.0f;
+        float maxAirStrength    = 0.0f;
+        float groundDPS         = 0.0f;     // Damage per frame against the opponent's sizes
+        float airDPS            = 0.0f;
+        int size                = 0;        // 0 small, 1 medium, 2 large
+
+        bool exists             = true;
+        bool flyer              = false;
+        bool worker             = false;
+        bool building           = false;
+        bool siege              = false;
+        bool stasised           = false;
+        bool morphing           = false;
+        bool completed          = true;
+        bool disabled           = false;    // Maelstrommed or stasised
+    };
+
+    /// The simulation core. It owns every unit and all map data, and never calls into BWAPI.
+    class Simulator {
+    public:
+        /// The inputs a cached result was simulated with.
+        struct Signature {
+            float engageX           = 0.0f;
+            float engageY           = 0.0f;
+            float simTime           = 0.0f;
+            float enemyStrength     = 0.0f;     // Strength in the cells around the engage position
+            float allyStrength      = 0.0f;     // Strength in the cells around the target
+            Engine engine           = Engine::Linear;
+            int frame               = -1;
+        };
+
+        /// A unit's data plus everything the simulator derives from it.
+        struct Record {
+            UnitData data;
+            Handle targetHandle;                // Stale once the target is removed
+            bool targetMine         = false;
+            float percentHealth     = 0.0f;
+            float visGroundStrength = 0.0f;
+            float visAirStrength    = 0.0f;
+            int engageX             = 0;
+            int engageY             = 0;
+            float engageDist        = 0.0f;
+            int targetX             = -1;
+            int targetY             = -1;
+            int targetWidth         = 0;
+            Signature signature;
+            HorizonOutput cached;
+            int blockX              = 0;        // Tiles this unit blocks right now, none while blockWidth is 0
+            int blockY              = 0;
+            int blockWidth          = 0;
+            int blockHeight         = 0;
+            bool groundPending      = false;    // Engage distance is the straight line until the field to the target is built
+        };
+
+    private:
+        // Units are kept in stable pool slots, the records hold everything about a unit while the store holds the flat copy the kernels read
+        struct UnitList {
+            Pool<Record> records = Pool<Record>(MaxUnits);
+            IdTable ids = IdTable(MaxUnits);
+            UnitStore store;
+            SpatialHash grid;
+
+            UnitList() { store.reset(MaxUnits); }
+            Record* find(int id);
+            int insert(int id);
+            void erase(int id);
+        };
+
+        // Everything a simulation reads about the unit being simulated
+        struct SimQuery {
+            Kernel::EnemyQuery enemy;
+            Kernel::AllyQuery ally;
+            Engine engine;
+        };
+
+        // Our units whose engage positions fall in the same cell share one simulation
+        struct Cluster {
+            float engageX           = 0.0f;     // Sum of the members' engage positions until the mean is taken
+            float engageY           = 0.0f;
+            int members             = 0;
+            int representative      = -1;       // Output of the member closest to the mean
+            float closest           = 0.0f;
+        };
+
+        // Read-only copy of the world that parallel simulations share, active units only and sorted by grid cell
+        // so that the units near a position are a few contiguous ranges
+        struct Snapshot {
+            UnitStore enemies;
+            UnitStore allies;
+            std::vector<int> enemyCells;        // Where each cell starts in the store, plus one past the last
+            std::vector<int> allyCells;
+            std::vector<float> enemyStrength;   // Ground and air strength summed per cell
+            std::vector<float> allyStrength;
+            int gridWidth           = 1;
+            int gridHeight          = 1;
+            float enemySpeed        = 0.0f;     // Largest values in each store, to bound how far away a unit can matter
+            float enemyGroundRange  = 0.0f;
+            float enemyAirRange     = 0.0f;
+            float enemyWidth        = 0.0f;
+            float allySpeed         = 0.0f;
+            std::vector<int> slots;             // Slot of each output's unit
+            std::vector<int> indices;           // Which query each output reads
+            std::vector<Signature> signatures;  // What each output is cached with
+            std::vector<SimQuery> requests;     // What each output would be simulated with
+            std::vector<int> priority;          // Outputs that are simulated every frame
+            std::vector<int> idle;              // Outputs that are simulated while there's budget left, oldest first
+            std::vector<SimQuery> queries;
+            std::vector<HorizonOutput> outputs;
+            std::map<std::tuple<int, int, bool>, int> clusterKeys;
+            std::vector<Cluster> clusters;
+        };
+
+        // Simulations running on a background thread against their own copy of the world
+        struct AsyncJob {
+            Snapshot world;
+            std::vector<int> ids;               // Unit each query is for
+            std::vector<int> sets;              // Parameters each query is simulated with
+            std::vector<std::pair<float, Engine>> parameters;
+            int frame               = 0;
+            bool started            = false;    // Its results haven't been published yet
+            std::unique_ptr<Worker> worker;     // Last, so it finishes before the world is destroyed
+        };
+
+        UnitList enemyUnits;
+        UnitList myUnits;
+        UpdateCounters counters;
+        TileGrid groundHeights;
+        TileGrid terrainWalkable;
+        TileGrid buildingTiles;
+        TileGrid walkable;
+        DistanceCache distances;
+        int distanceBudget = 4096;
+        Snapshot snapshot;
+        bool dirty = true;                      // Units or the map changed since the snapshot was taken
+        std::unique_ptr<ThreadPool> threadPool;
+        std::vector<std::pair<int, HorizonOutput>> outputs;
+        std::vector<HorizonOutput> curve;
+        std::vector<Kernel::Term> enemyTerms;
+        std::vector<Kernel::Term> allyTerms;
+        float clusterRadius = 0.0f;
+        CacheTolerance cacheTolerance;
+        CacheStats cacheStats;
+        Schedule schedule;
+        bool async = false;
+        AsyncJob job;                           // After the thread pool, so it finishes before the pool is destroyed
+        std::map<std::pair<float, Engine>, int> requested;  // Simulation times and engines asked for, and the last frame they were
+        std::map<std::pair<float, Engine>, std::map<int, HorizonOutput>> completed;
+        int completedFrame = 0;
+        std::unique_ptr<Trace::Writer> trace;
+
+        int groundHeight(int x, int y) const { return groundHeights.get(x / 32, y / 32); }
+        Record* getTarget(const Record& record);
+        void occupyTiles(int tileX, int tileY, int width, int height, int adj);
+        void placeBuilding(Record& record);
+        void eraseUnit(int id);
+        bool canAddToSim(const Record& record);
+        void writeStore(UnitStore& store, int slot, const Record& record);
+        void prepare();
+        void layout(const UnitList& list, UnitStore& store, std::vector<int>& cells, std::vector<float>& strengths);
+        void takeSnapshot();
+        void refreshSnapshot();
+        void cluster(const std::vector<int>& batch, int begin, int end);
+        void simulateBatch(const std::vector<int>& batch, int begin, int end);
+        void pollAsync(float simTime, Engine engine);
+        void waitAsync();
+        HorizonOutput completedValue(int id, float simTime, Engine engine) const;
+        float nearbyStrength(const std::vector<float>& strengths, float x, float y, int reach) const;
+        SimQuery makeQuery(const Record& record, float simTime, Engine engine);
+        static HorizonOutput simulate(const Snapshot& world, const SimQuery& query);
+        Signature sign(const SimQuery& query) const;
+        bool reusable(const Record& record, const Signature& signature) const;
+        HorizonOutput querySimValue(int id, float simTime, Engine engine);
+        void querySimValues(float simTime, Engine engine);
+        void querySimCurve(int id, const std::vector<float>& simTimes);
+
+    public:
+        Simulator();
+        ~Simulator();
+
+        /// Sets the ground height and walkability of every tile, both grids must be the same size.
+        void setMap(const TileGrid& heights, const TileGrid& walkableTiles);
+        bool hasMap() const                                 { return !groundHeights.empty(); }
+        const TileGrid& getGroundHeights() const            { return groundHeights; }
+
+        /// Starts counting a new frame's work if the frame changed.
+        void setFrame(int frame);
+        const UpdateCounters& getUpdateCounters() const     { return counters; }
+
+        /// Adds or updates a unit, recomputing only what changed. Returns how many groups of values were recomputed.
+        /// Units beyond MaxUnits on one side are ignored.
+        int updateUnit(const UnitData& unit);
+        void removeUnit(int id);
+
+        /// Marks whether a unit is currently visible, units that aren't keep the state they were last seen with.
+        void setExists(int id, bool exists);
+        const Record* find(int id);
+
+        /// Returns the walking distance in pixels between two positions, at least the straight line distance, or a negative value if there is no ground path.
+        float getGroundDistance(int x1, int y1, int x2, int y2);
+
+        /// Distance fields updateUnit needs are built at the start of each frame, settling up to this many tiles per frame. Units use the straight line to their target until then.
+        void setDistanceBudget(int tilesPerFrame);
+        int getDistanceBudget() const                       { return distanceBudget; }
+
+        /// Runs a simulation for one of our units.
+        HorizonOutput getSimValue(int id, float simTime, Engine engine = Engine::Linear);
+
+        /// Simulates one of our units for several simulation times at once, returning an output per time in the same order.
+        /// Always runs on the calling thread with the linear engine and doesn't use the cache.
+        const std::vector<HorizonOutput>& getSimCurve(int id, const std::vector<float>& simTimes);
+
+        /// Runs a simulation for every one of our units that exists, in a single pass.
+        const std::vector<std::pair<int, HorizonOutput>>& getSimValues(float simTime, Engine engine = Engine::Linear);
+
+        /// Groups our units whose engage positions share a cell of this many pixels, getSimValues then runs one simulation per group. 0 or less simulates every unit.
+        void setClusterRadius(float radius);
+        float getClusterRadius() const                      { return clusterRadius; }
+
+        /// Reuses a unit's last result while its inputs stay within these tolerances, for both getSimValue and getSimValues.
+        void setCacheTolerance(const CacheTolerance& tolerance);
+        const CacheTolerance& getCacheTolerance() const     { return cacheTolerance; }
+        const CacheStats& getCacheStats() const             { return cacheStats; }
+        void resetCacheStats()                              { cacheStats = CacheStats(); }
+
+        /// Our units fighting or under attack are simulated every frame, the rest round-robin within the budget and keep their latest result meanwhile.
+        void setSchedule(const Schedule& newSchedule);
+        const Schedule& getSchedule() const                 { return schedule; }
+
+        /// Simulates on a background thread instead. getSimValue and getSimValues then start the next simulation of the current world if the last one
+        /// finished, and return the latest completed results with their age in frames. Each simulation covers every simulation time and engine queried
+        /// this frame or the last. Units without a completed result for theirs return an empty output with an age of -1.
+        void setAsync(bool enabled);
+        bool isAsync() const                                { return async; }
+
+        /// Sets how many threads getSimValues splits its simulations across, including the calling thread.
+        void setThreads(int threads);
+
+        /// Records the settings, the map, every unit and every call that changes or queries them to a trace file from now on, see Trace.h.
+        /// Returns false if the file couldn't be opened.
+        bool startTrace(const std::string& path);
+        void stopTrace();
+    };
+}
@@ -0,0 +1,343 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <list>
+#include <map>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "Grid.h"
+
+namespace Horizon {
+
+    /// Walkable ground distance from every tile to the nearest tile of a goal region.
+    /// Distances are stored in chamfer steps, 10 per straight tile and 14 per diagonal tile.
+    class DistanceField {
+        std::vector<int> dist;
+        std::vector<int> goals;
+        int width   = 0;
+        int height  = 0;
+
+        using Node = std::pair<int, int>;
+        using Queue = std::priority_queue<Node, std::vector<Node>, std::greater<Node>>;
+        Queue pending;                          // Tiles left to settle while the field is being built
+
+        static constexpr int dx[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+        static constexpr int dy[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+        static constexpr int cost[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+
+        bool passable(const TileGrid& walkable, int x, int y) const { return walkable.get(x, y) != 0; }
+
+        // Diagonal moves can't cut the corner of an unwalkable tile
+        bool canStep(const TileGrid& walkable, int x, int y, int d) const {
+            const auto nx = x + dx[d];
+            const auto ny = y + dy[d];
+            if (!passable(walkable, nx, ny))
+                return false;
+            return d < 4 || (passable(walkable, nx, y) && passable(walkable, x, ny));
+        }
+
+        // Settles tiles until the queue is empty or the budget of tiles runs out
+        void propagate(const TileGrid& walkable, Queue& open, int& budget) {
+            for (; !open.empty() && budget > 0; budget--) {
+                const auto [d, index] = open.top();
+                open.pop();
+                if (d > dist[index])
+                    continue;
+
+                const auto x = index % width;
+                const auto y = index / width;
+                for (int i = 0; i < 8; i++) {
+                    if (!canStep(walkable, x, y, i))
+                        continue;
+                    const auto next = (y + dy[i]) * width + (x + dx[i]);
+                    if (d + cost[i] < dist[next]) {
+                        dist[next] = d + cost[i];
+                        open.push({ dist[next], next });
+                    }
+                }
+            }
+        }
+
+        // The best distance this tile can get from neighbours that aren't flagged
+        int bestNeighbour(const TileGrid& walkable, const std::vector<bool>& flagged, int x, int y) const {
+            auto best = INT_MAX;
+            for (int i = 0; i < 8; i++) {
+                const auto nx = x + dx[i];
+                const auto ny = y + dy[i];
+                if (!passable(walkable, nx, ny))
+                    continue;
+                const auto n = ny * width + nx;
+                if (flagged[n] || dist[n] == INT_MAX)
+                    continue;
+
+                // Moves are symmetric, so a step from the neighbour is legal if a step to it is
+                if (canStep(walkable, x, y, i))
+                    best = std::min(best, dist[n] + cost[i]);
+            }
+            return best;
+        }
+
+        bool isGoal(int index) const { return std::find(goals.begin(), goals.end(), index) != goals.end(); }
+
+    public:
+        static constexpr int Unreachable = INT_MAX;
+
+        /// Starts building the field from scratch, goal tiles that aren't walkable are ignored. advance finishes it.
+        void start(const TileGrid& walkable, const std::vector<int>& goalTiles) {
+            width = walkable.getWidth();
+            height = walkable.getHeight();
+            goals = goalTiles;
+            dist.assign(size_t(width) * height, Unreachable);
+
+            pending = Queue();
+            for (auto &g : goals) {
+                if (passable(walkable, g % width, g / width)) {
+                    dist[g] = 0;
+                    pending.push({ 0, g });
+                }
+            }
+        }
+
+        /// Settles up to budget tiles of a field being built, taking what it used from the budget. Returns true once the field is complete.
+        bool advance(const TileGrid& walkable, int& budget) {
+            propagate(walkable, pending, budget);
+            return pending.empty();
+        }
+
+        /// Builds the field from scratch in one go.
+        void build(const TileGrid& walkable, const std::vector<int>& goalTiles) {
+            auto unlimited = INT_MAX;
+            start(walkable, goalTiles);
+            advance(walkable, unlimited);
+        }
+
+        /// Starts over towards the same goals, for a field still being built when the walkable tiles change.
+        void restart(const TileGrid& walkable) {
+            const auto goalTiles = goals;
+            start(walkable, goalTiles);
+        }
+
+        /// Updates the field after this tile stopped being walkable, only tiles whose shortest path could have used it are recomputed.
+        void block(const TileGrid& walkable, int x, int y) {
+            if (x < 0 || y < 0 || x >= width || y >= height)
+                return;
+
+            // The blocked tile and its neighbours (which may have lost a diagonal) seed the invalidation
+            std::vector<bool> flagged(dist.size(), false);
+            std::vector<int> affected;
+            std::vector<int> stack;
+            for (int i = -1; i < 8; i++) {
+                const auto nx = i < 0 ? x : x + dx[i];
+                const auto ny = i < 0 ? y : y + dy[i];
+                if (nx >= 0 && ny >= 0 && nx < width && ny < height)
+                    stack.push_back(ny * width + nx);
+            }
+
+            // Anything that was reached through a flagged tile along a shortest step is flagged too
+            while (!stack.empty()) {
+                const auto index = stack.back();
+                stack.pop_back();
+                if (flagged[index] || dist[index] == Unreachable)
+                    continue;
+
+                flagged[index] = true;
+                affected.push_back(index);
+                const auto cx = index % width;
+                const auto cy = index / width;
+                for (int i = 0; i < 8; i++) {
+                    const auto nx = cx + dx[i];
+                    const auto ny = cy + dy[i];
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                        continue;
+                    const auto n = ny * width + nx;
+                    if (!flagged[n] && dist[n] != Unreachable && dist[n] == dist[index] + cost[i])
+                        stack.push_back(n);
+                }
+            }
+
+            // Reseed the flagged tiles from the untouched boundary around them
+            Queue open;
+            for (auto &index : affected) {
+                const auto cx = index % width;
+                const auto cy = index / width;
+                dist[index] = Unreachable;
+                if (!passable(walkable, cx, cy))
+                    continue;
+                if (isGoal(index)) {
+                    dist[index] = 0;
+                    open.push({ 0, index });
+                }
+            }
+            for (auto &index : affected) {
+                const auto cx = index % width;
+                const auto cy = index / width;
+                if (dist[index] == 0 || !passable(walkable, cx, cy))
+                    continue;
+                const auto best = bestNeighbour(walkable, flagged, cx, cy);
+                if (best < dist[index]) {
+                    dist[index] = best;
+                    open.push({ best, index });
+                }
+            }
+            auto unlimited = INT_MAX;
+            propagate(walkable, open, unlimited);
+        }
+
+        /// Updates the field after this tile became walkable, distances can only shrink so only improvements are propagated.
+        void unblock(const TileGrid& walkable, int x, int y) {
+            if (x < 0 || y < 0 || x >= width || y >= height)
+                return;
+
+            // Freeing a tile can also open diagonals between its neighbours, so relax all of them
+            const std::vector<bool> none(dist.size(), false);
+            Queue open;
+            for (int i = -1; i < 8; i++) {
+                const auto nx = i < 0 ? x : x + dx[i];
+                const auto ny = i < 0 ? y : y + dy[i];
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height || !passable(walkable, nx, ny))
+                    continue;
+
+                const auto index = ny * width + nx;
+                const auto best = isGoal(index) ? 0 : bestNeighbour(walkable, none, nx, ny);
+                if (best < dist[index])
+                    dist[index] = best;
+                if (dist[index] != Unreachable)
+                    open.push({ dist[index], index });
+            }
+            auto unlimited = INT_MAX;
+            propagate(walkable, open, unlimited);
+        }
+
+        /// Returns the ground distance in pixels from this tile to the goal, or a negative value if it can't be reached.
+        float getDistance(int x, int y) const {
+            if (x < 0 || y < 0 || x >= width || y >= height || dist[y * width + x] == Unreachable)
+                return -1.0f;
+            return float(dist[y * width + x]) * 3.2f;
+        }
+    };
+
+    /// Keeps the most recently used distance fields, keyed by the goal region they lead to.
+    class DistanceCache {
+        std::list<std::pair<int, DistanceField>> fields;
+        std::map<int, std::list<std::pair<int, DistanceField>>::iterator> lookup;
+        std::vector<int> pending;               // Regions asked for by findField that haven't been started yet, oldest first
+        DistanceField partial;                  // The field buildPending is part way through
+        int partialKey = -1;
+        size_t capacity = 32;
+
+        int regionOf(const TileGrid& walkable, int x, int y) const {
+            return (y / RegionSize) * ((walkable.getWidth() + RegionSize - 1) / RegionSize) + x / RegionSize;
+        }
+
+        std::vector<int> goalsOf(const TileGrid& walkable, int key) const {
+            const auto regions = (walkable.getWidth() + RegionSize - 1) / RegionSize;
+            const auto rx = key % regions;
+            const auto ry = key / regions;
+
+            std::vector<int> goals;
+            for (int gy = ry * RegionSize; gy < (ry + 1) * RegionSize && gy < walkable.getHeight(); gy++) {
+                for (int gx = rx * RegionSize; gx < (rx + 1) * RegionSize && gx < walkable.getWidth(); gx++)
+                    goals.push_back(gy * walkable.getWidth() + gx);
+            }
+            return goals;
+        }
+
+        const DistanceField* cached(int key) {
+            auto itr = lookup.find(key);
+            if (itr == lookup.end())
+                return nullptr;
+            fields.splice(fields.begin(), fields, itr->second);
+            return &itr->second->second;
+        }
+
+        const DistanceField& insert(int key, DistanceField&& field) {
+            fields.emplace_front(key, std::move(field));
+            lookup[key] = fields.begin();
+            setCapacity(capacity);
+            return fields.front().second;
+        }
+
+    public:
+        static constexpr int RegionSize = 4;
+
+        void clear() {
+            fields.clear();
+            lookup.clear();
+            pending.clear();
+            partialKey = -1;
+        }
+
+        void setCapacity(size_t c) {
+            capacity = std::max(size_t(1), c);
+            while (fields.size() > capacity) {
+                lookup.erase(fields.back().first);
+                fields.pop_back();
+            }
+        }
+
+        /// Returns the field leading to the region containing this tile, building it if it isn't cached.
+        const DistanceField& getField(const TileGrid& walkable, int x, int y) {
+            const auto key = regionOf(walkable, x, y);
+            if (auto field = cached(key))
+                return *field;
+
+            DistanceField field;
+            if (key == partialKey) {
+                auto unlimited = INT_MAX;
+                partial.advance(walkable, unlimited);
+                field = std::move(partial);
+                partialKey = -1;
+            }
+            else
+                field.build(walkable, goalsOf(walkable, key));
+            return insert(key, std::move(field));
+        }
+
+        /// Returns the field leading to the region containing this tile, or nullptr after queueing it for buildPending if it isn't cached.
+        const DistanceField* findField(const TileGrid& walkable, int x, int y) {
+            const auto key = regionOf(walkable, x, y);
+            auto field = cached(key);
+            if (!field && key != partialKey && std::find(pending.begin(), pending.end(), key) == pending.end())
+                pending.push_back(key);
+            return field;
+        }
+
+        /// Builds queued fields, oldest request first, until this many tiles have been settled. A field the budget runs out on is resumed next time.
+        /// Returns how many fields were finished.
+        int buildPending(const TileGrid& walkable, int budget) {
+            auto built = 0;
+            while (budget > 0) {
+                if (partialKey < 0) {
+                    while (!pending.empty() && lookup.count(pending.front()))
+                        pending.erase(pending.begin());
+                    if (pending.empty())
+                        break;
+                    partialKey = pending.front();
+                    pending.erase(pending.begin());
+                    partial.start(walkable, goalsOf(walkable, partialKey));
+                }
+                if (!partial.advance(walkable, budget))
+                    break;
+                insert(partialKey, std::move(partial));
+                partialKey = -1;
+                built++;
+            }
+            return built;
+        }
+
+        void block(const TileGrid& walkable, int x, int y) {
+            for (auto &[key, field] : fields)
+                field.block(walkable, x, y);
+            if (partialKey >= 0)
+                partial.restart(walkable);
+        }
+
+        void unblock(const TileGrid& walkable, int x, int y) {
+            for (auto &[key, field] : fields)
+                field.unblock(walkable, x, y);
+            if (partialKey >= 0)
+                partial.restart(walkable);
+        }
+    };
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace Horizon {
+
+    /// A packed byte per tile, each row starts on its own cache line.
+    class TileGrid {
+        std::vector<uint8_t> storage;
+        uint8_t* cells  = nullptr;
+        int width       = 0;
+        int height      = 0;
+        int stride      = 0;
+    public:
+        static constexpr int CacheLine = 64;
+
+        TileGrid() = default;
+        TileGrid(TileGrid&&) = default;
+        TileGrid& operator=(TileGrid&&) = default;
+        TileGrid(const TileGrid& other) { *this = other; }
+
+        // Rows have to be realigned in the new storage
+        TileGrid& operator=(const TileGrid& other) {
+            if (this == &other)
+                return *this;
+            resize(other.width, other.height);
+            for (int y = 0; y < height; y++)
+                std::copy(other.row(y), other.row(y) + width, cells + y * stride);
+            return *this;
+        }
+
+        void resize(int w, int h) {
+            width = w;
+            height = h;
+            stride = (w + CacheLine - 1) / CacheLine * CacheLine;
+            storage.assign(size_t(stride) * h + CacheLine, 0);
+
+            const auto misalign = reinterpret_cast<uintptr_t>(storage.data()) % CacheLine;
+            cells = storage.data() + (misalign ? CacheLine - misalign : 0);
+        }
+
+        bool valid(int x, int y) const          { return x >= 0 && y >= 0 && x < width && y < height; }
+        uint8_t get(int x, int y) const         { return valid(x, y) ? cells[y * stride + x] : 0; }
+        void set(int x, int y, uint8_t value)   { if (valid(x, y)) cells[y * stride + x] = value; }
+
+        const uint8_t* row(int y) const         { return cells + y * stride; }
+        int getWidth() const                    { return width; }
+        int getHeight() const                   { return height; }
+        int getStride() const                   { return stride; }
+        bool empty() const                      { return width == 0 || height == 0; }
+    };
+}
@@ -1,163 +1,241 @@
 #include "Horizon.h"
 #include "Maths.h"
+#include "Stats.h"
 
 namespace Horizon {
 
     namespace {
-        float simulationTime;
-        std::map<BWAPI::Unit, HorizonUnit> enemyUnits;
-        std::map<BWAPI::Unit, HorizonUnit> myUnits;
-
-        void simulate(HorizonOutput& newOutput, HorizonUnit& unit) {
-
-            float enemyGrdSim;
-            float enemyAirSim;
-            float myGrdSim;
-            float myAirSim;
-            float unitSpeed = unit.getSpeed() * 24.0f;
-            bool sync = false;
-
-            const auto canAddToSim = [&](HorizonUnit& u) {
-                if (!u.unit()
-                    || u.getType().isWorker()
-                    || (u.unit()->exists() && (u.unit()->isStasised() || u.unit()->isMorphing() || !u.unit()->isCompleted()))
-                    || (u.getVisibleAirStrength() <= 0.0 && u.getVisibleGroundStrength() <= 0.0))
-                    return false;
-                return true;
-            };
-
-            const auto simEnemies = [&]() {
-                for (auto &e : enemyUnits) {
-                    auto &enemy = e.second;
-                    if (!canAddToSim(enemy))
-                        continue;
-
-                    const auto enemyRange = unit.getType().isFlyer() ? enemy.getAirRange() : enemy.getGroundRange();
-                    const auto widths = double(enemy.getType().width() + unit.getType().width()) / 2.0;
-                    const auto distance = std::max(0.0, enemy.getPosition().getDistance(unit.getEngagePosition()) - enemyRange - widths);
-                    const auto speed = enemy.getSpeed() > 0.0 ? 24.0 * enemy.getSpeed() : 24.0 * unit.getSpeed();
-                    auto simRatio = simulationTime - (distance / speed);
-
-                    // If the unit doesn't affect this simulation
-                    if (simRatio <= 0.0
-                        || (enemy.getSpeed() <= 0.0 && distance > 0.0)
-                        || (enemy.getType() == BWAPI::UnitTypes::Terran_Siege_Tank_Siege_Mode && (enemy.getPosition().getDistance(unit.getPosition()) - widths) < 64.0))
-                        continue;
-
-                    // High ground bonus
-                    if (!enemy.getType().isFlyer() && BWAPI::Broodwar->getGroundHeight(enemy.getTilePosition()) > BWAPI::Broodwar->getGroundHeight(BWAPI::TilePosition(unit.getEngagePosition())))
-                        simRatio = simRatio * 2.0;
-
-                    // Add their values to the simulation
-                    enemyGrdSim += enemy.getVisibleGroundStrength() * simRatio;
-                    enemyAirSim += enemy.getVisibleAirStrength() * simRatio;
-                }
-            };
-
-            const auto simSelf = [&]() {
-                for (auto &a : myUnits) {
-                    auto &ally = a.second;
-                    if (!canAddToSim(ally))
-                        continue;
-
-                    const auto widths = double(ally.getType().width() + ally.getTarget().getType().width()) / 2.0;
-                    const auto distance = std::max(0.0, ally.getEngageDist() - widths);
-                    const auto speed = 24.0 * ally.getSpeed();
-                    auto simRatio = simulationTime - (distance / speed);
-
-                    // If the unit doesn't affect this simulation
-                    if (simRatio <= 0.0
-                        || (ally.getSpeed() <= 0.0 && distance > 0.0)
-                        || (ally.getPosition().getDistance(unit.getTarget().getPosition()) / speed) > simulationTime
-                        || (ally.getType() == BWAPI::UnitTypes::Terran_Siege_Tank_Siege_Mode && unit.getTarget().getPosition().getDistance(ally.getPosition()) < 64.0))
-                        continue;
-                    
-                    // High ground bonus
-                    if (!ally.getType().isFlyer() && BWAPI::Broodwar->getGroundHeight(BWAPI::TilePosition(ally.getEngagePosition())) > BWAPI::Broodwar->getGroundHeight(TilePosition(ally.getTarget().getPosition())))
-                        simRatio = simRatio * 2.0;                    
-
-                    // Add their values to the simulation
-                    myGrdSim += ally.getVisibleGroundStrength() * simRatio;
-                    myAirSim += ally.getVisibleAirStrength() * simRatio;
-
-                    // Check if air/ground sim needs to sync
-                    if (!sync && simRatio > 0.0 && ((unit.getType().isFlyer() && !ally.getType().isFlyer()) || (!unit.getType().isFlyer() && ally.getType().isFlyer())))
-                        sync = true;
-                }
-            };
+        // Both sides share one pool keyed by unit id. It's built on first use, since a HorizonUnit's defaults are BWAPI constants
+        // that may not be initialized yet when this file's globals are
+        Pool<HorizonUnit>& getUnits() {
+            static Pool<HorizonUnit> units(MaxUnits * 2);
+            return units;
+        }
+        IdTable unitIds(MaxUnits * 2);
+        std::map<BWAPI::Unit, HorizonOutput> outputs;
+        Simulator simulator;
+
+        int refreshedFrame = -1;
+
+        // Units that left vision aren't updated, the simulator keeps the state they were last seen with. Once a frame is enough, since it can't change within one
+        void refreshExists() {
+            const auto frame = Profile::call(BWAPI::Broodwar->getFrameCount());
+            if (frame == refreshedFrame)
+                return;
+            refreshedFrame = frame;
+
+            auto &units = getUnits();
+            for (auto slot : units.slots()) {
+                auto unit = units[slot].unit();
+                simulator.setExists(Profile::call(unit->getID()), Profile::call(unit->exists()));
+            }
+        }
+    }
 
-            simEnemies();
-            simSelf();
+    void onStart() {
+        TileGrid groundHeights;
+        groundHeights.resize(BWAPI::Broodwar->mapWidth(), BWAPI::Broodwar->mapHeight());
+        for (int y = 0; y < groundHeights.getHeight(); y++) {
+            for (int x = 0; x < groundHeights.getWidth(); x++)
+                groundHeights.set(x, y, uint8_t(BWAPI::Broodwar->getGroundHeight(x, y)));
+        }
 
-            newOutput.attackAirAsAir =          enemyAirSim > 0.0f ? myAirSim / enemyAirSim : 10.0f;
-            newOutput.attackAirAsGround =       enemyGrdSim > 0.0f ? myAirSim / enemyGrdSim : 10.0f;
-            newOutput.attackGroundAsAir =       enemyAirSim > 0.0f ? myGrdSim / enemyAirSim : 10.0f;
-            newOutput.attackGroundasGround =    enemyGrdSim > 0.0f ? myGrdSim / enemyGrdSim : 10.0f;
-            newOutput.shouldSynch =             sync;
+        // A tile is walkable if at least half of its mini-tiles are
+        TileGrid walkable;
+        walkable.resize(BWAPI::Broodwar->mapWidth(), BWAPI::Broodwar->mapHeight());
+        for (int y = 0; y < walkable.getHeight(); y++) {
+            for (int x = 0; x < walkable.getWidth(); x++) {
+                auto count = 0;
+                for (int wx = x * 4; wx < x * 4 + 4; wx++) {
+                    for (int wy = y * 4; wy < y * 4 + 4; wy++)
+                        count += BWAPI::Broodwar->isWalkable(wx, wy);
+                }
+                walkable.set(x, y, count >= 8);
+            }
         }
+        simulator.setMap(groundHeights, walkable);
     }
 
-    HorizonOutput getSimValue(BWAPI::Unit u, float simTime) {
-        HorizonOutput newOutput;
+    const TileGrid& getGroundHeights() {
+        if (!simulator.hasMap())
+            onStart();
+        return simulator.getGroundHeights();
+    }
 
-        if (!u->exists() || u->getPlayer() != BWAPI::Broodwar->self())
-            return newOutput;
+    float getGroundDistance(BWAPI::Position from, BWAPI::Position to) {
+        if (!simulator.hasMap())
+            onStart();
+        return simulator.getGroundDistance(from.x, from.y, to.x, to.y);
+    }
 
-        HorizonUnit &unit = myUnits[u];
-        float unitToEngage = float(std::max(0.0, unit.getPosition().getDistance(unit.getEngagePosition()) / (24.0 * unit.getSpeed())));
-        simulationTime = unitToEngage + simTime;
-        simulate(newOutput, unit);
-        return newOutput;
+    HorizonOutput getSimValue(BWAPI::Unit u, float simTime, Engine engine) {
+        if (!Profile::call(u->exists()) || Profile::call(u->getPlayer()) != Profile::call(BWAPI::Broodwar->self()))
+            return HorizonOutput();
+
+        refreshExists();
+        return simulator.getSimValue(Profile::call(u->getID()), simTime, engine);
     }
 
-    void updateUnit(BWAPI::Unit unit, BWAPI::Unit target) {
+    std::vector<HorizonOutput> getSimCurve(BWAPI::Unit u, const std::vector<float>& simTimes) {
+        if (!Profile::call(u->exists()) || Profile::call(u->getPlayer()) != Profile::call(BWAPI::Broodwar->self()))
+            return std::vector<HorizonOutput>(simTimes.size());
+
+        refreshExists();
+        return simulator.getSimCurve(Profile::call(u->getID()), simTimes);
+    }
+
+    std::map<BWAPI::Unit, HorizonOutput> getSimValues(float simTime, Engine engine) {
+        outputs.clear();
+        refreshExists();
+        for (auto &[id, output] : simulator.getSimValues(simTime, engine))
+            outputs[Profile::call(BWAPI::Broodwar->getUnit(id))] = output;
+        return outputs;
+    }
+
+    void setClusterRadius(float radius) {
+        simulator.setClusterRadius(radius);
+    }
+
+    void setCacheTolerance(const CacheTolerance& tolerance) {
+        simulator.setCacheTolerance(tolerance);
+    }
+
+    CacheStats getCacheStats() {
+        return simulator.getCacheStats();
+    }
 
-        if (!unit || !unit->exists())
+    void setSchedule(const Schedule& schedule) {
+        simulator.setSchedule(schedule);
+    }
+
+    void setAsync(bool enabled) {
+        simulator.setAsync(enabled);
+    }
+
+    void setThreads(int threads) {
+        simulator.setThreads(threads);
+    }
+
+    void updateUnit(BWAPI::Unit unit, BWAPI::Unit target) {
+        HORIZON_TIMER(AdapterUpdate);
+        if (!unit || !Profile::call(unit->exists()))
             return;
 
-        auto &u = unit->getPlayer() == BWAPI::Broodwar->self() ? myUnits[unit] : enemyUnits[unit];
-        Maths::adjustSizes(unit);
-        u.update(unit, target);
+        if (!simulator.hasMap())
+            onStart();
+
+        auto &units = getUnits();
+        const auto id = Profile::call(unit->getID());
+        auto slot = unitIds.find(id);
+        if (slot < 0) {
+            slot = units.acquire().slot;
+            if (slot < 0)
+                return;
+            unitIds.insert(id, slot);
+        }
 
+        auto &u = units[slot];
+        u.update(unit, target);
+        simulator.setFrame(Profile::call(BWAPI::Broodwar->getFrameCount()));
+        simulator.updateUnit(u.getData());
     }
 
     void removeUnit(BWAPI::Unit unit)
     {
-        unit->getPlayer() == BWAPI::Broodwar->self() ? myUnits.erase(unit) : enemyUnits.erase(unit);
-        Maths::adjustSizes(unit);
+        const auto id = Profile::call(unit->getID());
+        if (const auto slot = unitIds.find(id); slot >= 0) {
+            auto &units = getUnits();
+            Maths::adjustSizes(units[slot].getPlayer(), units[slot].getType(), -1);
+            units.release(slot);
+            unitIds.erase(id);
+        }
+        simulator.removeUnit(id);
+    }
+
+    UpdateCounters getUpdateCounters() {
+        return simulator.getUpdateCounters();
+    }
+
+    Simulator& getSimulator() {
+        return simulator;
     }
 
     void HorizonUnit::update(BWAPI::Unit unit, BWAPI::Unit target) {
-        auto t = unit->getType();
-        auto p = unit->getPlayer();
-
-        unitsTarget = nullptr;
-        if (target) {
-            if (myUnits.find(target) != myUnits.end())
-                unitsTarget = &myUnits[target];
-            else if (enemyUnits.find(target) != enemyUnits.end())
-                unitsTarget = &enemyUnits[target];
+        auto t = Profile::call(unit->getType());
+        auto p = Profile::call(unit->getPlayer());
+
+        // A new unit, morph or mind control invalidates everything
+        if (thisUnit != unit || type != t || player != p) {
+            if (type != BWAPI::UnitTypes::None)
+                Maths::adjustSizes(player, type, -1);
+            Maths::adjustSizes(p, t, 1);
+
+            thisUnit = unit;
+            type = t;
+            player = p;
+            statsVersion = -1;
         }
 
-        thisUnit = unit;
-        type = t;
-        player = p;
-        position = unit->getPosition();
-        tilePosition = unit->getTilePosition();
-        energy = unit->getEnergy();
-
-        percentHealth = Maths::percentHealth(*this);
-        groundRange = Maths::groundRange(*this);
-        groundDamage = Maths::groundDamage(*this);
-        airRange = Maths::airRange(*this);
-        airDamage = Maths::airDamage(*this);
-        speed = Maths::speed(*this);
-        visGroundStrength = Maths::visGroundStrength(*this);
-        visAirStrength = Maths::visAirStrength(*this);
-
-        // Here is where you can add custom pathfinding to designate where you expect this Unit to engage its target and how far away the target is
-        // Right now this assumes we are going to engage on a linear line to the target
-        engageDist = position.getDistance(engagePosition);
-        engagePosition = Maths::engagePosition(myUnits[unit]);
-    }
-}
\ No newline at end of file
+        // Upgrades or research finished
+        const auto &stats = Stats::getStats(type, player);
+        const auto statsChanged = stats.version != statsVersion;
+        if (statsChanged) {
+            statsVersion = stats.version;
+            groundRange = stats.groundRange;
+            groundDamage = stats.groundDamage;
+            airRange = stats.airRange;
+            airDamage = stats.airDamage;
+            speed = stats.speed;
+        }
+
+        // Effectiveness depends on the sizes of every opposing unit, carriers depend on their interceptors
+        if (statsChanged || sizesVersion != Maths::sizesVersion || type == BWAPI::UnitTypes::Protoss_Carrier) {
+            sizesVersion = Maths::sizesVersion;
+            maxGroundStrength = Maths::maxGroundStrength(*this, stats.groundStrength);
+            maxAirStrength = Maths::maxAirStrength(*this, stats.airStrength);
+            groundDPS = stats.groundDPS * Maths::effectiveness(*this);
+            airDPS = stats.airDPS * Maths::effectiveness(*this);
+        }
+
+        // Each of these is a call into BWAPI, as are the type and player above, everything else comes from type data. Profile::call counts them
+        const auto position = Profile::call(unit->getPosition());
+        const auto flying = Profile::call(unit->isFlying());
+        const auto tile = Profile::call(unit->getTilePosition());
+        const auto stasised = Profile::call(unit->isStasised());
+        const auto maelstrommed = Profile::call(unit->isMaelstrommed());
+        energy = Profile::call(unit->getEnergy());
+        data.id = Profile::call(unit->getID());
+        data.target = target ? Profile::call(target->getID()) : -1;
+        data.mine = player == Profile::call(BWAPI::Broodwar->self());
+        data.hitPoints = Profile::call(unit->getHitPoints());
+        data.shields = Profile::call(unit->getShields());
+        data.morphing = Profile::call(unit->isMorphing());
+        data.completed = Profile::call(unit->isCompleted());
+
+        data.type = type.getID();
+        data.x = position.x;
+        data.y = position.y;
+        data.tileX = tile.x;
+        data.tileY = tile.y;
+        data.width = type.width();
+        data.tileWidth = type.tileWidth();
+        data.tileHeight = type.tileHeight();
+        data.maxHitPoints = type.maxHitPoints();
+        data.maxShields = type.maxShields();
+        data.groundRange = groundRange;
+        data.airRange = airRange;
+        data.speed = speed;
+        data.maxGroundStrength = maxGroundStrength;
+        data.maxAirStrength = maxAirStrength;
+        data.groundDPS = groundDPS;
+        data.airDPS = airDPS;
+        data.size = type.size() == BWAPI::UnitSizeTypes::Large ? 2 : type.size() == BWAPI::UnitSizeTypes::Medium ? 1 : 0;
+        data.exists = true;
+        data.flyer = type.isFlyer() || flying;
+        data.worker = type.isWorker();
+        data.building = type.isBuilding();
+        data.siege = type == BWAPI::UnitTypes::Terran_Siege_Tank_Siege_Mode;
+        data.stasised = stasised;
+        data.disabled = maelstrommed || stasised;
+    }
+}
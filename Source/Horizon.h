@@ -1,79 +1,99 @@
 #pragma once
 #include <BWAPI.h>
+#include "Core.h"
 
 namespace Horizon {
 
-    struct HorizonOutput {
-        float attackAirAsAir       = 0.0;
-        float attackAirAsGround    = 0.0;
-        float attackGroundAsAir    = 0.0;
-        float attackGroundasGround = 0.0;
-        bool shouldSynch            = false;
-    };
-
     class HorizonUnit {
 
-        HorizonUnit* unitsTarget;
-
-        float percentHealth     = 0.0f;
         float groundRange       = 0.0f;
         float airRange          = 0.0f;
         float groundDamage      = 0.0f;
         float airDamage         = 0.0f;
         float speed             = 0.0f;
-        float visGroundStrength = 0.0f; 
-        float visAirStrength    = 0.0f;
         float maxGroundStrength = 0.0f;
         float maxAirStrength    = 0.0f;
-        float engageDist        = 0.0f;
-        int shields             = 0;
-        int health              = 0;
+        float groundDPS         = 0.0f;
+        float airDPS            = 0.0f;
         int energy              = 0;
+        int statsVersion        = -1;
+        int sizesVersion        = -1;
 
         BWAPI::Unit thisUnit             = nullptr;
         BWAPI::UnitType type             = BWAPI::UnitTypes::None;
         BWAPI::Player player             = nullptr;
-        BWAPI::Position position         = BWAPI::Positions::None;
-        BWAPI::Position engagePosition   = BWAPI::Positions::None;
-        BWAPI::TilePosition tilePosition = BWAPI::TilePositions::None;
+        UnitData data;
     public:
         HorizonUnit() { };
-        void update(BWAPI::Unit unit, BWAPI::Unit target = nullptr);
-
-        bool hasTarget()                        { return unitsTarget != nullptr; }
-        HorizonUnit &getTarget()                { return *unitsTarget; }
 
-        void setEngage(BWAPI::Position p)       { engagePosition = p; }
+        /// Reads the Unit from BWAPI, recomputing stats and strength only when the Unit, its owner's research or opposing sizes changed.
+        void update(BWAPI::Unit unit, BWAPI::Unit target = nullptr);
 
         BWAPI::Unit unit()                      { return thisUnit; }
         BWAPI::UnitType getType()               { return type; }
         BWAPI::Player getPlayer()               { return player; }
-        BWAPI::Position getPosition()           { return position; }
-        BWAPI::Position getEngagePosition()     { return engagePosition; }
-        BWAPI::TilePosition getTilePosition()   { return tilePosition; }
+        const UnitData& getData()               { return data; }
 
-        float getPercentHealth()               { return percentHealth; }
-        float getVisibleGroundStrength()       { return visGroundStrength; }
         float getMaxGroundStrength()           { return maxGroundStrength; }
-        float getVisibleAirStrength()          { return visAirStrength; }
         float getMaxAirStrength()              { return maxAirStrength; }
         float getGroundRange()                 { return groundRange; }
         float getAirRange()                    { return airRange; }
         float getGroundDamage()                { return groundDamage; }
         float getAirDamage()                   { return airDamage; }
         float getSpeed()                       { return speed; }
-        float getEngageDist()                  { return engageDist; }
+        float getGroundDPS()                   { return groundDPS; }
+        float getAirDPS()                      { return airDPS; }
         int getEnergy()                        { return energy; }
     };
 
+    /// Takes a snapshot of the map, call this at the start of every game.
+    void onStart();
+
+    /// Returns the snapshot of every tile's ground height.
+    const TileGrid& getGroundHeights();
+
+    /// Returns the walking distance in pixels between two positions, at least the straight line distance, or a negative value if there is no ground path.
+    float getGroundDistance(BWAPI::Position, BWAPI::Position);
+
     /// Runs a simulation for this Unit and percent change of winning.    
-    HorizonOutput getSimValue(BWAPI::Unit, float);
+    HorizonOutput getSimValue(BWAPI::Unit, float, Engine = Engine::Linear);
+
+    /// Runs a simulation for this Unit at each of the given simulation times, sharing the work that doesn't depend on time.
+    std::vector<HorizonOutput> getSimCurve(BWAPI::Unit, const std::vector<float>&);
+
+    /// Runs a simulation for every one of your Units in a single pass.
+    std::map<BWAPI::Unit, HorizonOutput> getSimValues(float, Engine = Engine::Linear);
+
+    /// Groups your Units whose engage positions are within the same cell of this many pixels, getSimValues then simulates each group once. 0 simulates every Unit, which is the default.
+    void setClusterRadius(float);
+
+    /// Reuses each Unit's last simulation while its engage position, simulation time and nearby strengths stay within these tolerances.
+    void setCacheTolerance(const CacheTolerance&);
+
+    /// Returns how often a cached simulation was reused, to tune the tolerances against.
+    CacheStats getCacheStats();
+
+    /// Limits how long getSimValues spends each frame. Units that are fighting or have enemies next to them are always simulated, the rest take turns within the budget.
+    void setSchedule(const Schedule&);
+
+    /// Runs simulations on a background thread while your bot keeps going. getSimValue and getSimValues return the latest finished results, their age says how many frames old they are.
+    /// A Unit with no finished result for the simulation time and engine asked for yet gets an empty HorizonOutput with an age of -1.
+    void setAsync(bool);
+
+    /// Sets how many threads getSimValues splits its simulations across, including the calling thread. 1 or less runs them all on the calling thread.
+    void setThreads(int);
 
     /// Adds a Unit to Horizon.
     void updateUnit(BWAPI::Unit, BWAPI::Unit = nullptr);
 
     /// Removes the Unit from Horizon.
     void removeUnit(BWAPI::Unit);
+
+    /// Returns how much work updateUnit and the simulations did this frame.
+    UpdateCounters getUpdateCounters();
+
+    /// Returns the simulation core, which can also be driven without BWAPI.
+    Simulator& getSimulator();
 };
 
 
@@ -0,0 +1,324 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Profile.h"
+#include "Store.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HORIZON_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HORIZON_SSE2
+#endif
+
+namespace Horizon::Kernel {
+
+#if defined(HORIZON_AVX2)
+    constexpr const char* Name = "AVX2";
+#elif defined(HORIZON_SSE2)
+    constexpr const char* Name = "SSE2";
+#else
+    constexpr const char* Name = "scalar";
+#endif
+
+#ifdef HORIZON_PROFILE
+    inline int countLanes(int mask) {
+        auto count = 0;
+        for (; mask; mask &= mask - 1)
+            count++;
+        return count;
+    }
+#endif
+
+    // Every unit in a visited range is considered, the ones the checks turn away are culled. This runs per row of cells, so it only tallies
+    inline void countUnits([[maybe_unused]] int begin, [[maybe_unused]] int end, [[maybe_unused]] int kept) {
+        HORIZON_TALLY(Considered, end - begin);
+        HORIZON_TALLY(Accumulated, kept);
+        HORIZON_TALLY(Culled, end - begin - kept);
+    }
+
+    /// Everything about the simulated unit that the per-enemy accumulation needs.
+    struct EnemyQuery {
+        float engageX;
+        float engageY;
+        float unitX;
+        float unitY;
+        float width;
+        float speed;                // Pixels per second
+        float height;               // Ground height at the engage position
+        float simTime;
+        bool flyer;
+    };
+
+    /// Everything about the simulated unit that the per-ally accumulation needs.
+    struct AllyQuery {
+        float targetX;
+        float targetY;
+        float simTime;
+        bool flyer;
+    };
+
+    /// One enemy at a time version of simEnemies, always built so the SIMD kernels can be checked against it. Returns how many enemies it counted.
+    inline int simEnemiesScalar(const UnitStore& store, int begin, int end, const EnemyQuery& q, float& grdSim, float& airSim) {
+        const auto range = q.flyer ? store.airRange.data() : store.groundRange.data();
+        auto kept = 0;
+
+        for (int i = begin; i < end; i++) {
+            const auto widths = (store.width[i] + q.width) * 0.5f;
+            const auto distance = std::max(0.0f, std::hypot(store.x[i] - q.engageX, store.y[i] - q.engageY) - range[i] - widths);
+            const auto speed = store.speed[i] > 0.0f ? store.speed[i] : q.speed;
+            auto simRatio = q.simTime - (distance / speed);
+
+            // If the unit doesn't affect this simulation
+            if (!(simRatio > 0.0f)
+                || store.active[i] <= 0.0f
+                || (store.speed[i] <= 0.0f && distance > 0.0f)
+                || (store.siege[i] > 0.0f && (std::hypot(store.x[i] - q.unitX, store.y[i] - q.unitY) - widths) < 64.0f))
+                continue;
+            kept++;
+
+            // High ground bonus
+            if (store.flyer[i] <= 0.0f && store.height[i] > q.height)
+                simRatio = simRatio * 2.0f;
+
+            // Add their values to the simulation
+            grdSim += store.groundStrength[i] * simRatio;
+            airSim += store.airStrength[i] * simRatio;
+        }
+        return kept;
+    }
+
+    /// Accumulates the strength every active enemy in [begin, end) of the store brings to this engagement.
+    /// Lanes past the end are masked off, so the store needs 8 readable entries past it.
+    inline void simEnemies(const UnitStore& store, int begin, int end, const EnemyQuery& q, float& grdSim, float& airSim) {
+        [[maybe_unused]] const auto range = q.flyer ? store.airRange.data() : store.groundRange.data();
+        auto kept = 0;
+
+#if defined(HORIZON_AVX2)
+        const auto zero = _mm256_setzero_ps();
+        const auto half = _mm256_set1_ps(0.5f);
+        const auto two = _mm256_set1_ps(2.0f);
+        const auto siegeDist = _mm256_set1_ps(64.0f);
+        const auto engageX = _mm256_set1_ps(q.engageX);
+        const auto engageY = _mm256_set1_ps(q.engageY);
+        const auto unitX = _mm256_set1_ps(q.unitX);
+        const auto unitY = _mm256_set1_ps(q.unitY);
+        const auto unitWidth = _mm256_set1_ps(q.width);
+        const auto unitSpeed = _mm256_set1_ps(q.speed);
+        const auto unitHeight = _mm256_set1_ps(q.height);
+        const auto simTime = _mm256_set1_ps(q.simTime);
+        const auto lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const auto last = _mm256_set1_epi32(end);
+        auto grd = zero;
+        auto air = zero;
+
+        for (int i = begin; i < end; i += 8) {
+            const auto x = _mm256_loadu_ps(&store.x[i]);
+            const auto y = _mm256_loadu_ps(&store.y[i]);
+            const auto speed = _mm256_loadu_ps(&store.speed[i]);
+            const auto widths = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(&store.width[i]), unitWidth), half);
+
+            const auto ex = _mm256_sub_ps(x, engageX);
+            const auto ey = _mm256_sub_ps(y, engageY);
+            const auto engageDist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)));
+            const auto distance = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_sub_ps(engageDist, _mm256_loadu_ps(&range[i])), widths));
+
+            const auto moving = _mm256_cmp_ps(speed, zero, _CMP_GT_OQ);
+            auto simRatio = _mm256_sub_ps(simTime, _mm256_div_ps(distance, _mm256_blendv_ps(unitSpeed, speed, moving)));
+
+            const auto ux = _mm256_sub_ps(x, unitX);
+            const auto uy = _mm256_sub_ps(y, unitY);
+            const auto unitDist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(ux, ux), _mm256_mul_ps(uy, uy)));
+            const auto sieged = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&store.siege[i]), zero, _CMP_GT_OQ), _mm256_cmp_ps(_mm256_sub_ps(unitDist, widths), siegeDist, _CMP_LT_OQ));
+            const auto stranded = _mm256_andnot_ps(moving, _mm256_cmp_ps(distance, zero, _CMP_GT_OQ));
+
+            // If the unit doesn't affect this simulation
+            const auto inRange = _mm256_castsi256_ps(_mm256_cmpgt_epi32(last, _mm256_add_epi32(_mm256_set1_epi32(i), lanes)));
+            auto keep = _mm256_and_ps(_mm256_cmp_ps(simRatio, zero, _CMP_GT_OQ), _mm256_cmp_ps(_mm256_loadu_ps(&store.active[i]), zero, _CMP_GT_OQ));
+            keep = _mm256_and_ps(inRange, _mm256_andnot_ps(_mm256_or_ps(sieged, stranded), keep));
+#ifdef HORIZON_PROFILE
+            kept += countLanes(_mm256_movemask_ps(keep));
+#endif
+
+            // High ground bonus
+            const auto bonus = _mm256_andnot_ps(_mm256_cmp_ps(_mm256_loadu_ps(&store.flyer[i]), zero, _CMP_GT_OQ), _mm256_cmp_ps(_mm256_loadu_ps(&store.height[i]), unitHeight, _CMP_GT_OQ));
+            simRatio = _mm256_and_ps(keep, _mm256_blendv_ps(simRatio, _mm256_mul_ps(simRatio, two), bonus));
+
+            // Add their values to the simulation
+            grd = _mm256_add_ps(grd, _mm256_mul_ps(_mm256_loadu_ps(&store.groundStrength[i]), simRatio));
+            air = _mm256_add_ps(air, _mm256_mul_ps(_mm256_loadu_ps(&store.airStrength[i]), simRatio));
+        }
+
+        alignas(32) float grdLanes[8];
+        alignas(32) float airLanes[8];
+        _mm256_store_ps(grdLanes, grd);
+        _mm256_store_ps(airLanes, air);
+        for (int l = 0; l < 8; l++) {
+            grdSim += grdLanes[l];
+            airSim += airLanes[l];
+        }
+
+#elif defined(HORIZON_SSE2)
+        const auto zero = _mm_setzero_ps();
+        const auto half = _mm_set1_ps(0.5f);
+        const auto siegeDist = _mm_set1_ps(64.0f);
+        const auto engageX = _mm_set1_ps(q.engageX);
+        const auto engageY = _mm_set1_ps(q.engageY);
+        const auto unitX = _mm_set1_ps(q.unitX);
+        const auto unitY = _mm_set1_ps(q.unitY);
+        const auto unitWidth = _mm_set1_ps(q.width);
+        const auto unitSpeed = _mm_set1_ps(q.speed);
+        const auto unitHeight = _mm_set1_ps(q.height);
+        const auto simTime = _mm_set1_ps(q.simTime);
+        const auto lanes = _mm_setr_epi32(0, 1, 2, 3);
+        const auto last = _mm_set1_epi32(end);
+        auto grd = zero;
+        auto air = zero;
+
+        for (int i = begin; i < end; i += 4) {
+            const auto x = _mm_loadu_ps(&store.x[i]);
+            const auto y = _mm_loadu_ps(&store.y[i]);
+            const auto speed = _mm_loadu_ps(&store.speed[i]);
+            const auto widths = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&store.width[i]), unitWidth), half);
+
+            const auto ex = _mm_sub_ps(x, engageX);
+            const auto ey = _mm_sub_ps(y, engageY);
+            const auto engageDist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)));
+            const auto distance = _mm_max_ps(zero, _mm_sub_ps(_mm_sub_ps(engageDist, _mm_loadu_ps(&range[i])), widths));
+
+            const auto moving = _mm_cmpgt_ps(speed, zero);
+            const auto pickedSpeed = _mm_or_ps(_mm_and_ps(moving, speed), _mm_andnot_ps(moving, unitSpeed));
+            auto simRatio = _mm_sub_ps(simTime, _mm_div_ps(distance, pickedSpeed));
+
+            const auto ux = _mm_sub_ps(x, unitX);
+            const auto uy = _mm_sub_ps(y, unitY);
+            const auto unitDist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ux, ux), _mm_mul_ps(uy, uy)));
+            const auto sieged = _mm_and_ps(_mm_cmpgt_ps(_mm_loadu_ps(&store.siege[i]), zero), _mm_cmplt_ps(_mm_sub_ps(unitDist, widths), siegeDist));
+            const auto stranded = _mm_andnot_ps(moving, _mm_cmpgt_ps(distance, zero));
+
+            // If the unit doesn't affect this simulation
+            const auto inRange = _mm_castsi128_ps(_mm_cmpgt_epi32(last, _mm_add_epi32(_mm_set1_epi32(i), lanes)));
+            auto keep = _mm_and_ps(_mm_cmpgt_ps(simRatio, zero), _mm_cmpgt_ps(_mm_loadu_ps(&store.active[i]), zero));
+            keep = _mm_and_ps(inRange, _mm_andnot_ps(_mm_or_ps(sieged, stranded), keep));
+#ifdef HORIZON_PROFILE
+            kept += countLanes(_mm_movemask_ps(keep));
+#endif
+
+            // High ground bonus, doubles the ratio by adding it to itself
+            const auto bonus = _mm_andnot_ps(_mm_cmpgt_ps(_mm_loadu_ps(&store.flyer[i]), zero), _mm_cmpgt_ps(_mm_loadu_ps(&store.height[i]), unitHeight));
+            simRatio = _mm_and_ps(keep, _mm_add_ps(simRatio, _mm_and_ps(bonus, simRatio)));
+
+            // Add their values to the simulation
+            grd = _mm_add_ps(grd, _mm_mul_ps(_mm_loadu_ps(&store.groundStrength[i]), simRatio));
+            air = _mm_add_ps(air, _mm_mul_ps(_mm_loadu_ps(&store.airStrength[i]), simRatio));
+        }
+
+        alignas(16) float grdLanes[4];
+        alignas(16) float airLanes[4];
+        _mm_store_ps(grdLanes, grd);
+        _mm_store_ps(airLanes, air);
+        for (int l = 0; l < 4; l++) {
+            grdSim += grdLanes[l];
+            airSim += airLanes[l];
+        }
+
+#else
+        kept = simEnemiesScalar(store, begin, end, q, grdSim, airSim);
+#endif
+        countUnits(begin, end, kept);
+    }
+
+    /// Accumulates the strength every active ally in [begin, end) of the store brings to this engagement, returns true if air and ground should synchronize.
+    inline bool simAllies(const UnitStore& store, int begin, int end, const AllyQuery& q, float& grdSim, float& airSim) {
+        auto sync = false;
+        auto kept = 0;
+
+        for (int i = begin; i < end; i++) {
+            auto simRatio = q.simTime - store.engageTime[i];
+
+            // If the unit doesn't affect this simulation
+            const auto targetDist = std::hypot(store.x[i] - q.targetX, store.y[i] - q.targetY);
+            if (!(simRatio > 0.0f)
+                || store.active[i] <= 0.0f
+                || store.stranded[i] > 0.0f
+                || (targetDist / store.speed[i]) > q.simTime
+                || (store.siege[i] > 0.0f && targetDist < 64.0f))
+                continue;
+            kept++;
+
+            // High ground bonus
+            if (store.highGround[i] > 0.0f)
+                simRatio = simRatio * 2.0f;
+
+            // Add their values to the simulation
+            grdSim += store.groundStrength[i] * simRatio;
+            airSim += store.airStrength[i] * simRatio;
+
+            // Check if air/ground sim needs to sync
+            if (q.flyer != (store.flyer[i] > 0.0f))
+                sync = true;
+        }
+        countUnits(begin, end, kept);
+        return sync;
+    }
+
+    /// The part of a unit's contribution that doesn't depend on the simulation time.
+    /// It adds strength * (simTime - arrival) once simTime is past arrival and at least gate.
+    struct Term {
+        float arrival;
+        float gate;
+        float grdStrength;
+        float airStrength;
+        bool sync;
+    };
+
+    /// Collects the terms of every active enemy in [begin, end) of the store, the same enemies simEnemies would count given enough time.
+    inline void enemyTerms(const UnitStore& store, int begin, int end, const EnemyQuery& q, std::vector<Term>& terms) {
+        const auto range = q.flyer ? store.airRange.data() : store.groundRange.data();
+
+        for (int i = begin; i < end; i++) {
+            const auto widths = (store.width[i] + q.width) * 0.5f;
+            const auto distance = std::max(0.0f, std::hypot(store.x[i] - q.engageX, store.y[i] - q.engageY) - range[i] - widths);
+            const auto speed = store.speed[i] > 0.0f ? store.speed[i] : q.speed;
+
+            if (store.active[i] <= 0.0f
+                || (store.speed[i] <= 0.0f && distance > 0.0f)
+                || (store.siege[i] > 0.0f && (std::hypot(store.x[i] - q.unitX, store.y[i] - q.unitY) - widths) < 64.0f))
+                continue;
+
+            const auto bonus = (store.flyer[i] <= 0.0f && store.height[i] > q.height) ? 2.0f : 1.0f;
+            terms.push_back({ distance / speed, 0.0f, store.groundStrength[i] * bonus, store.airStrength[i] * bonus, false });
+        }
+    }
+
+    /// Collects the terms of every active ally in [begin, end) of the store, the same allies simAllies would count given enough time.
+    inline void allyTerms(const UnitStore& store, int begin, int end, const AllyQuery& q, std::vector<Term>& terms) {
+        for (int i = begin; i < end; i++) {
+            const auto targetDist = std::hypot(store.x[i] - q.targetX, store.y[i] - q.targetY);
+            if (store.active[i] <= 0.0f
+                || store.stranded[i] > 0.0f
+                || (store.siege[i] > 0.0f && targetDist < 64.0f))
+                continue;
+
+            const auto bonus = store.highGround[i] > 0.0f ? 2.0f : 1.0f;
+            terms.push_back({ store.engageTime[i], targetDist / store.speed[i], store.groundStrength[i] * bonus, store.airStrength[i] * bonus, q.flyer != (store.flyer[i] > 0.0f) });
+        }
+    }
+
+    /// Adds up the terms for one simulation time, returns true if any counted term asks air and ground to synchronize.
+    inline bool sweep(const std::vector<Term>& terms, float simTime, float& grdSim, float& airSim) {
+        auto sync = false;
+        for (auto &term : terms) {
+            const auto simRatio = simTime - term.arrival;
+            if (!(simRatio > 0.0f) || term.gate > simTime)
+                continue;
+
+            grdSim += term.grdStrength * simRatio;
+            airSim += term.airStrength * simRatio;
+            sync = sync || term.sync;
+        }
+        return sync;
+    }
+}
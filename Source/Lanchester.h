@@ -0,0 +1,212 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Kernel.h"
+#include "Store.h"
+
+namespace Horizon::Lanchester {
+
+    constexpr int Steps = 16;
+    constexpr int Buckets = 6;                  // Ground then air, each split into small, medium and large
+
+    /// One unit's part in the fight, everything that doesn't depend on how the fight goes.
+    struct Fighter {
+        float arrival;                          // Seconds until it joins the fight
+        float grdStrength;                      // Already doubled for high ground
+        float airStrength;
+        float hitPoints;
+        float groundDPS;
+        float airDPS;
+        int bucket;
+    };
+
+    namespace {
+        int bucketOf(const UnitStore& store, int i) {
+            return (store.flyer[i] > 0.0f ? 3 : 0) + std::clamp(int(store.sizeClass[i]), 0, 2);
+        }
+
+        // Pools the hit points, strength and damage of every fighter in each bucket as they arrive
+        struct Side {
+            const std::vector<Fighter>* fighters = nullptr;
+            int next = 0;
+            float hitPoints[Buckets] = {};
+            float damage[Buckets] = {};
+            float grdStrength[Buckets] = {};
+            float airStrength[Buckets] = {};
+            float groundDPS[Buckets] = {};
+            float airDPS[Buckets] = {};
+            float alive[Buckets] = {};
+
+            bool pending() const { return next < int(fighters->size()); }
+
+            void updateAlive() {
+                for (int b = 0; b < Buckets; b++)
+                    alive[b] = hitPoints[b] > 0.0f ? std::max(0.0f, 1.0f - damage[b] / hitPoints[b]) : 1.0f;
+            }
+
+            float aliveHitPoints(int first, int last) const {
+                auto total = 0.0f;
+                for (int b = first; b < last; b++)
+                    total += hitPoints[b] * alive[b];
+                return total;
+            }
+
+            // Spreads damage over the buckets it can hit by how many hit points each has left
+            void takeDamage(float amount, int first, int last) {
+                const auto total = aliveHitPoints(first, last);
+                if (total <= 0.0f)
+                    return;
+                for (int b = first; b < last; b++)
+                    damage[b] += amount * hitPoints[b] * alive[b] / total;
+            }
+
+            // Accumulates strength over [start, end) and returns the ground and air damage dealt in it, fighters arriving part way only count from when they arrive
+            void fight(float start, float end, float& grdSim, float& airSim, float& groundDamage, float& airDamage) {
+                const auto dt = end - start;
+                for (int b = 0; b < Buckets; b++) {
+                    grdSim += grdStrength[b] * alive[b] * dt;
+                    airSim += airStrength[b] * alive[b] * dt;
+                    groundDamage += groundDPS[b] * alive[b] * dt;
+                    airDamage += airDPS[b] * alive[b] * dt;
+                }
+
+                for (; pending() && (*fighters)[next].arrival < end; next++) {
+                    auto &f = (*fighters)[next];
+                    const auto active = end - std::max(start, f.arrival);
+                    grdSim += f.grdStrength * alive[f.bucket] * active;
+                    airSim += f.airStrength * alive[f.bucket] * active;
+                    groundDamage += f.groundDPS * alive[f.bucket] * active;
+                    airDamage += f.airDPS * alive[f.bucket] * active;
+
+                    hitPoints[f.bucket] += f.hitPoints;
+                    grdStrength[f.bucket] += f.grdStrength;
+                    airStrength[f.bucket] += f.airStrength;
+                    groundDPS[f.bucket] += f.groundDPS;
+                    airDPS[f.bucket] += f.airDPS;
+                }
+            }
+
+            // Once the other side is gone nothing changes, so the rest of the fight adds up linearly
+            void finish(float start, float end, float& grdSim, float& airSim) {
+                for (int b = 0; b < Buckets; b++) {
+                    grdSim += grdStrength[b] * alive[b] * (end - start);
+                    airSim += airStrength[b] * alive[b] * (end - start);
+                }
+                for (; pending(); next++) {
+                    auto &f = (*fighters)[next];
+                    grdSim += f.grdStrength * alive[f.bucket] * (end - std::max(start, f.arrival));
+                    airSim += f.airStrength * alive[f.bucket] * (end - std::max(start, f.arrival));
+                }
+            }
+        };
+    }
+
+    /// Collects every active enemy in [begin, end) of the store that joins the fight before the simulation ends.
+    inline void gatherEnemies(const UnitStore& store, int begin, int end, const Kernel::EnemyQuery& q, std::vector<Fighter>& fighters) {
+        const auto range = q.flyer ? store.airRange.data() : store.groundRange.data();
+        const auto gathered = fighters.size();
+
+        for (int i = begin; i < end; i++) {
+            const auto dx = store.x[i] - q.engageX;
+            const auto dy = store.y[i] - q.engageY;
+            const auto ux = store.x[i] - q.unitX;
+            const auto uy = store.y[i] - q.unitY;
+            const auto widths = (store.width[i] + q.width) * 0.5f;
+            const auto distance = std::max(0.0f, std::sqrt(dx * dx + dy * dy) - range[i] - widths);
+            const auto speed = store.speed[i] > 0.0f ? store.speed[i] : q.speed;
+            const auto arrival = distance / speed;
+
+            if (!(q.simTime - arrival > 0.0f)
+                || store.active[i] <= 0.0f
+                || (store.speed[i] <= 0.0f && distance > 0.0f)
+                || (store.siege[i] > 0.0f && (std::sqrt(ux * ux + uy * uy) - widths) < 64.0f))
+                continue;
+
+            const auto bonus = (store.flyer[i] <= 0.0f && store.height[i] > q.height) ? 2.0f : 1.0f;
+            fighters.push_back({ arrival, store.groundStrength[i] * bonus, store.airStrength[i] * bonus, std::max(1.0f, store.hitPoints[i]), store.groundDPS[i], store.airDPS[i], bucketOf(store, i) });
+        }
+        Kernel::countUnits(begin, end, int(fighters.size() - gathered));
+    }
+
+    /// Collects every active ally in [begin, end) of the store that joins the fight before the simulation ends, returns true if air and ground should synchronize.
+    inline bool gatherAllies(const UnitStore& store, int begin, int end, const Kernel::AllyQuery& q, std::vector<Fighter>& fighters) {
+        auto sync = false;
+        const auto gathered = fighters.size();
+
+        for (int i = begin; i < end; i++) {
+            const auto tx = store.x[i] - q.targetX;
+            const auto ty = store.y[i] - q.targetY;
+            const auto targetDist = std::sqrt(tx * tx + ty * ty);
+            if (!(q.simTime - store.engageTime[i] > 0.0f)
+                || store.active[i] <= 0.0f
+                || store.stranded[i] > 0.0f
+                || (targetDist / store.speed[i]) > q.simTime
+                || (store.siege[i] > 0.0f && targetDist < 64.0f))
+                continue;
+
+            const auto bonus = store.highGround[i] > 0.0f ? 2.0f : 1.0f;
+            fighters.push_back({ store.engageTime[i], store.groundStrength[i] * bonus, store.airStrength[i] * bonus, std::max(1.0f, store.hitPoints[i]), store.groundDPS[i], store.airDPS[i], bucketOf(store, i) });
+
+            if (q.flyer != (store.flyer[i] > 0.0f))
+                sync = true;
+        }
+        Kernel::countUnits(begin, end, int(fighters.size() - gathered));
+        return sync;
+    }
+
+    /// Fights both sides out over a fixed number of steps, units only add strength for as long as their bucket survives.
+    /// Stops early once a side has nobody left and nobody on the way.
+    inline void simulate(std::vector<Fighter>& enemies, std::vector<Fighter>& allies, float simTime, float& enemyGrdSim, float& enemyAirSim, float& myGrdSim, float& myAirSim) {
+        const auto dt = simTime / float(Steps);
+
+        // Fighters only need to be in the order of the step they arrive in, so a counting sort is enough
+        thread_local std::vector<Fighter> sorted;
+        const auto byStep = [&](std::vector<Fighter>& fighters) {
+            int counts[Steps + 1] = {};
+            const auto stepOf = [&](const Fighter& f) { return std::clamp(int(f.arrival / dt), 0, Steps - 1); };
+            for (auto &f : fighters)
+                counts[stepOf(f) + 1]++;
+            for (int i = 0; i < Steps; i++)
+                counts[i + 1] += counts[i];
+
+            sorted.resize(fighters.size());
+            for (auto &f : fighters)
+                sorted[counts[stepOf(f)]++] = f;
+            fighters.swap(sorted);
+        };
+        byStep(enemies);
+        byStep(allies);
+
+        Side enemy, ally;
+        enemy.fighters = &enemies;
+        ally.fighters = &allies;
+
+        for (int step = 0; step < Steps; step++) {
+            const auto start = dt * float(step);
+            const auto end = start + dt;
+            enemy.updateAlive();
+            ally.updateAlive();
+
+            auto enemyGroundDamage = 0.0f, enemyAirDamage = 0.0f;
+            auto myGroundDamage = 0.0f, myAirDamage = 0.0f;
+            enemy.fight(start, end, enemyGrdSim, enemyAirSim, enemyGroundDamage, enemyAirDamage);
+            ally.fight(start, end, myGrdSim, myAirSim, myGroundDamage, myAirDamage);
+
+            enemy.takeDamage(myGroundDamage, 0, 3);
+            enemy.takeDamage(myAirDamage, 3, Buckets);
+            ally.takeDamage(enemyGroundDamage, 0, 3);
+            ally.takeDamage(enemyAirDamage, 3, Buckets);
+
+            enemy.updateAlive();
+            ally.updateAlive();
+            const auto enemyGone = !enemy.pending() && enemy.aliveHitPoints(0, Buckets) <= 0.0f;
+            const auto allyGone = !ally.pending() && ally.aliveHitPoints(0, Buckets) <= 0.0f;
+            if (enemyGone || allyGone) {
+                enemy.finish(end, simTime, enemyGrdSim, enemyAirSim);
+                ally.finish(end, simTime, myGrdSim, myAirSim);
+                break;
+            }
+        }
+    }
+}
@@ -5,33 +5,45 @@ namespace Horizon::Maths {
     namespace {
         std::map<BWAPI::UnitSizeType, int> mySizes;
         std::map<BWAPI::UnitSizeType, int> enemySizes;
+        int sizesVersion = 0;
     }
 
-    void adjustSizes(BWAPI::Unit unit) {
-        int adj = unit->exists() ? 1 : -1;
-        unit->getPlayer() == BWAPI::Broodwar->self() ? mySizes[unit->getType().size()] += adj : enemySizes[unit->getType().size()] += adj;
+    void adjustSizes(BWAPI::Player player, BWAPI::UnitType type, int adj) {
+        player == Profile::call(BWAPI::Broodwar->self()) ? mySizes[type.size()] += adj : enemySizes[type.size()] += adj;
+        sizesVersion++;
     }
 
-    float survivability(HorizonUnit& unit) {
-        const auto avgUnitSpeed = 4.34;
-        const auto speed = log(unit.getSpeed() + avgUnitSpeed);
-        const auto armor = 0.25 + float(unit.getType().armor() + unit.getPlayer()->getUpgradeLevel(unit.getType().armorUpgrade()));
-        const auto health = log(float(unit.getType().maxHitPoints() + unit.getType().maxShields()));
+    float speed(BWAPI::UnitType type, BWAPI::Player player) {
+        float speed = float(type.topSpeed());
+
+        if ((type == BWAPI::UnitTypes::Zerg_Zergling && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Metabolic_Boost))) || (type == BWAPI::UnitTypes::Zerg_Hydralisk && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Muscular_Augments))) || (type == BWAPI::UnitTypes::Zerg_Ultralisk && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Anabolic_Synthesis))) || (type == BWAPI::UnitTypes::Protoss_Shuttle && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Gravitic_Drive))) || (type == BWAPI::UnitTypes::Protoss_Observer && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Gravitic_Boosters))) || (type == BWAPI::UnitTypes::Protoss_Zealot && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Leg_Enhancements))) || (type == BWAPI::UnitTypes::Terran_Vulture && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Ion_Thrusters))))
+            return speed * 1.5f;
+        if (type == BWAPI::UnitTypes::Zerg_Overlord && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Pneumatized_Carapace))) return speed * 4.01f;
+        if (type == BWAPI::UnitTypes::Protoss_Scout && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Muscular_Augments))) return speed * 1.33f;
+        if (type.isBuilding()) return 0.0f;
+        return speed;
+    }
+
+    float survivability(BWAPI::UnitType type, BWAPI::Player player, float unitSpeed) {
+        constexpr auto avgUnitSpeed = 4.34;
+        const auto speed = log(unitSpeed + avgUnitSpeed);
+        const auto armor = 0.25 + float(type.armor() + Profile::call(player->getUpgradeLevel(type.armorUpgrade())));
+        const auto health = log(float(type.maxHitPoints() + type.maxShields()));
         return speed * armor * health;
     }
 
-    float splashModifier(HorizonUnit& unit) {
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_Archon || unit.getType() == BWAPI::UnitTypes::Terran_Firebat || unit.getType() == BWAPI::UnitTypes::Protoss_Reaver) return 1.25f;
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_High_Templar) return 4.00f;
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Siege_Tank_Siege_Mode) return 2.50f;
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Valkyrie || unit.getType() == BWAPI::UnitTypes::Zerg_Mutalisk) return 1.50f;
-        if (unit.getType() == BWAPI::UnitTypes::Zerg_Lurker) return 2.00f;
+    float splashModifier(BWAPI::UnitType type) {
+        if (type == BWAPI::UnitTypes::Protoss_Archon || type == BWAPI::UnitTypes::Terran_Firebat || type == BWAPI::UnitTypes::Protoss_Reaver) return 1.25f;
+        if (type == BWAPI::UnitTypes::Protoss_High_Templar) return 4.00f;
+        if (type == BWAPI::UnitTypes::Terran_Siege_Tank_Siege_Mode) return 2.50f;
+        if (type == BWAPI::UnitTypes::Terran_Valkyrie || type == BWAPI::UnitTypes::Zerg_Mutalisk) return 1.50f;
+        if (type == BWAPI::UnitTypes::Zerg_Lurker) return 2.00f;
         return 1.00f;
     }
 
     float effectiveness(HorizonUnit& unit) {
         auto effectiveness = 1.0f;
-        auto sizes = unit.getPlayer() == BWAPI::Broodwar->self() ? enemySizes : mySizes;
+        auto &sizes = unit.getPlayer() == Profile::call(BWAPI::Broodwar->self()) ? enemySizes : mySizes;
 
         auto large = sizes[BWAPI::UnitSizeTypes::Large];
         auto medium = sizes[BWAPI::UnitSizeTypes::Medium];
@@ -47,170 +59,141 @@ namespace Horizon::Maths {
         return effectiveness;
     }
 
-    float groundDamage(HorizonUnit& unit) {
-        int upLevel = unit.getPlayer()->getUpgradeLevel(unit.getType().groundWeapon().upgradeType());
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_Reaver) {
-            if (unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Scarab_Damage)) return 125.0f;
+    float groundDamage(BWAPI::UnitType type, BWAPI::Player player) {
+        int upLevel = Profile::call(player->getUpgradeLevel(type.groundWeapon().upgradeType()));
+        if (type == BWAPI::UnitTypes::Protoss_Reaver) {
+            if (Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Scarab_Damage))) return 125.0f;
             else return 100.0f;
         }
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Bunker) return 24.0f + (4.0f * upLevel);
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Firebat || unit.getType() == BWAPI::UnitTypes::Protoss_Zealot) return 16.0f + (2.0f * upLevel);
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_High_Templar) return 112.0f;
-        return float(unit.getType().groundWeapon().damageAmount() + (unit.getType().groundWeapon().damageBonus() * upLevel));
-    }
-
-    float groundRange(HorizonUnit& unit) {
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_Dragoon && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Singularity_Charge)) return 192.0f;
-        if ((unit.getType() == BWAPI::UnitTypes::Terran_Marine && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::U_238_Shells)) || (unit.getType() == BWAPI::UnitTypes::Zerg_Hydralisk && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Grooved_Spines))) return 160.0f;
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_High_Templar) return 288.0f;
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_Reaver) return 256.0f;
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Bunker) {
-            if (unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::U_238_Shells)) return 192.0f;
+        if (type == BWAPI::UnitTypes::Terran_Bunker) return 24.0f + (4.0f * upLevel);
+        if (type == BWAPI::UnitTypes::Terran_Firebat || type == BWAPI::UnitTypes::Protoss_Zealot) return 16.0f + (2.0f * upLevel);
+        if (type == BWAPI::UnitTypes::Protoss_High_Templar) return 112.0f;
+        return float(type.groundWeapon().damageAmount() + (type.groundWeapon().damageBonus() * upLevel));
+    }
+
+    float groundRange(BWAPI::UnitType type, BWAPI::Player player) {
+        if (type == BWAPI::UnitTypes::Protoss_Dragoon && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Singularity_Charge))) return 192.0f;
+        if ((type == BWAPI::UnitTypes::Terran_Marine && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::U_238_Shells))) || (type == BWAPI::UnitTypes::Zerg_Hydralisk && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Grooved_Spines)))) return 160.0f;
+        if (type == BWAPI::UnitTypes::Protoss_High_Templar) return 288.0f;
+        if (type == BWAPI::UnitTypes::Protoss_Reaver) return 256.0f;
+        if (type == BWAPI::UnitTypes::Terran_Bunker) {
+            if (Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::U_238_Shells))) return 192.0f;
             return 160.0f;
         }
-        return float(unit.getType().groundWeapon().maxRange());
+        return float(type.groundWeapon().maxRange());
     }
 
-    float gWeaponCooldown(HorizonUnit& unit) {
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Bunker) return 15.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Protoss_Reaver) return 60.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Protoss_High_Templar) return 224.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Zerg_Zergling && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Adrenal_Glands)) return 6.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Terran_Marine && unit.getPlayer()->hasResearched(BWAPI::TechTypes::Stim_Packs)) return 7.5f;
-        return float(unit.getType().groundWeapon().damageCooldown());
+    float gWeaponCooldown(BWAPI::UnitType type, BWAPI::Player player) {
+        if (type == BWAPI::UnitTypes::Terran_Bunker) return 15.0f;
+        else if (type == BWAPI::UnitTypes::Protoss_Reaver) return 60.0f;
+        else if (type == BWAPI::UnitTypes::Protoss_High_Templar) return 224.0f;
+        else if (type == BWAPI::UnitTypes::Zerg_Zergling && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Adrenal_Glands))) return 6.0f;
+        else if (type == BWAPI::UnitTypes::Terran_Marine && Profile::call(player->hasResearched(BWAPI::TechTypes::Stim_Packs))) return 7.5f;
+        return float(type.groundWeapon().damageCooldown());
     }
 
-    float groundDPS(HorizonUnit& unit) {
-        const auto splash = splashModifier(unit);
-        const auto damage = unit.getGroundDamage();
-        const auto cooldown = gWeaponCooldown(unit);
+    float groundDPS(BWAPI::UnitType type, BWAPI::Player player) {
+        const auto splash = splashModifier(type);
+        const auto damage = groundDamage(type, player);
+        const auto cooldown = gWeaponCooldown(type, player);
         return damage > 1.0 ? splash * damage / cooldown : 0.0;
     }
 
-    float visGroundStrength(HorizonUnit& unit) {
-        if (unit.unit()->isMaelstrommed() || unit.unit()->isStasised())
-            return 0.0f;
-        return unit.getPercentHealth() * unit.getMaxGroundStrength();
-    }
-
-    float maxGroundStrength(HorizonUnit& unit) {
+    float groundStrength(BWAPI::UnitType type, BWAPI::Player player) {
         // HACK: Some hardcoded values
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Medic)
+        if (type == BWAPI::UnitTypes::Terran_Medic)
             return 5.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Protoss_Scarab || unit.getType() == BWAPI::UnitTypes::Terran_Vulture_Spider_Mine || unit.getType() == BWAPI::UnitTypes::Zerg_Egg || unit.getType() == BWAPI::UnitTypes::Zerg_Larva || unit.getGroundRange() <= 0.0f)
+        else if (type == BWAPI::UnitTypes::Protoss_Scarab || type == BWAPI::UnitTypes::Terran_Vulture_Spider_Mine || type == BWAPI::UnitTypes::Zerg_Egg || type == BWAPI::UnitTypes::Zerg_Larva || groundRange(type, player) <= 0.0f)
             return 0.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Protoss_Interceptor)
+        else if (type == BWAPI::UnitTypes::Protoss_Interceptor)
             return 2.0f;
+
+        const auto dps = groundDPS(type, player);
+        const auto surv = log(survivability(type, player, speed(type, player)));
+        const auto range = log(groundRange(type, player));
+        return dps * range * surv;
+    }
+
+    float maxGroundStrength(HorizonUnit& unit, float strength) {
+        if (strength <= 0.0f)
+            return 0.0f;
         else if (unit.getType() == BWAPI::UnitTypes::Protoss_Carrier) {
             float cnt = 0.0f;
-            for (auto &i : unit.unit()->getInterceptors()) {
-                if (i && !i->exists()) {
+            for (auto &i : Profile::call(unit.unit()->getInterceptors())) {
+                if (i && !Profile::call(i->exists())) {
                     cnt += 2.0f;
                 }
             }
             return cnt;
         }
-
-        const auto dps = groundDPS(unit);
-        const auto surv = log(survivability(unit));
-        const auto eff = effectiveness(unit);
-        const auto range = log(unit.getGroundRange());
-        return dps * range * surv * eff;
-    }
-
-    float airDamage(HorizonUnit& unit) {
-        int upLevel = unit.getPlayer()->getUpgradeLevel(unit.getType().airWeapon().upgradeType());
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Bunker)	return 24.0f + (4.0f * upLevel);
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_Scout)	return 28.0f + (2.0f * upLevel);
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Valkyrie) return 48.0f + (8.0f * upLevel);
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_High_Templar) return 112.0f;
-        return float(unit.getType().airWeapon().damageAmount() + (unit.getType().airWeapon().damageBonus() * upLevel));
-    }
-
-    float airRange(HorizonUnit& unit) {
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_Dragoon && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Singularity_Charge)) return 192.0f;
-        if ((unit.getType() == BWAPI::UnitTypes::Terran_Marine && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::U_238_Shells)) || (unit.getType() == BWAPI::UnitTypes::Zerg_Hydralisk && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Grooved_Spines))) return 160.0f;
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Goliath && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Charon_Boosters)) return 256.0f;
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_High_Templar) return 288.0f;
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Bunker) {
-            if (unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::U_238_Shells)) return 192.0f;
+        else if (unit.getType() == BWAPI::UnitTypes::Terran_Medic || unit.getType() == BWAPI::UnitTypes::Protoss_Interceptor)
+            return strength;
+        return strength * effectiveness(unit);
+    }
+
+    float airDamage(BWAPI::UnitType type, BWAPI::Player player) {
+        int upLevel = Profile::call(player->getUpgradeLevel(type.airWeapon().upgradeType()));
+        if (type == BWAPI::UnitTypes::Terran_Bunker)	return 24.0f + (4.0f * upLevel);
+        if (type == BWAPI::UnitTypes::Protoss_Scout)	return 28.0f + (2.0f * upLevel);
+        if (type == BWAPI::UnitTypes::Terran_Valkyrie) return 48.0f + (8.0f * upLevel);
+        if (type == BWAPI::UnitTypes::Protoss_High_Templar) return 112.0f;
+        return float(type.airWeapon().damageAmount() + (type.airWeapon().damageBonus() * upLevel));
+    }
+
+    float airRange(BWAPI::UnitType type, BWAPI::Player player) {
+        if (type == BWAPI::UnitTypes::Protoss_Dragoon && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Singularity_Charge))) return 192.0f;
+        if ((type == BWAPI::UnitTypes::Terran_Marine && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::U_238_Shells))) || (type == BWAPI::UnitTypes::Zerg_Hydralisk && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Grooved_Spines)))) return 160.0f;
+        if (type == BWAPI::UnitTypes::Terran_Goliath && Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::Charon_Boosters))) return 256.0f;
+        if (type == BWAPI::UnitTypes::Protoss_High_Templar) return 288.0f;
+        if (type == BWAPI::UnitTypes::Terran_Bunker) {
+            if (Profile::call(player->getUpgradeLevel(BWAPI::UpgradeTypes::U_238_Shells))) return 192.0f;
             return 160.0f;
         }
-        return float(unit.getType().airWeapon().maxRange());
+        return float(type.airWeapon().maxRange());
     }
 
-    float aWeaponCooldown(HorizonUnit& unit)
-    {
-        if (unit.getType() == BWAPI::UnitTypes::Terran_Bunker) return 15.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Protoss_High_Templar) return 224.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Zerg_Scourge) return 110.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Zerg_Infested_Terran) return 500.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Terran_Marine && unit.getPlayer()->hasResearched(BWAPI::TechTypes::Stim_Packs)) return 7.5f;
-        return float(unit.getType().airWeapon().damageCooldown());
+    float aWeaponCooldown(BWAPI::UnitType type, BWAPI::Player player) {
+        if (type == BWAPI::UnitTypes::Terran_Bunker) return 15.0f;
+        else if (type == BWAPI::UnitTypes::Protoss_High_Templar) return 224.0f;
+        else if (type == BWAPI::UnitTypes::Zerg_Scourge) return 110.0f;
+        else if (type == BWAPI::UnitTypes::Zerg_Infested_Terran) return 500.0f;
+        else if (type == BWAPI::UnitTypes::Terran_Marine && Profile::call(player->hasResearched(BWAPI::TechTypes::Stim_Packs))) return 7.5f;
+        return float(type.airWeapon().damageCooldown());
     }
 
-    float airDPS(HorizonUnit& unit) {
-        const auto splash = splashModifier(unit);
-        const auto damage = unit.getAirDamage();
-        const auto cooldown = aWeaponCooldown(unit);
+    float airDPS(BWAPI::UnitType type, BWAPI::Player player) {
+        const auto splash = splashModifier(type);
+        const auto damage = airDamage(type, player);
+        const auto cooldown = aWeaponCooldown(type, player);
         return  damage > 1.0 ? splash * damage / cooldown : 0.0;
     }
 
-    float visAirStrength(HorizonUnit& unit) {
-        if (unit.unit()->isMaelstrommed() || unit.unit()->isStasised())
+    float airStrength(BWAPI::UnitType type, BWAPI::Player player) {
+        if (type == BWAPI::UnitTypes::Protoss_Scarab || type == BWAPI::UnitTypes::Terran_Vulture_Spider_Mine || type == BWAPI::UnitTypes::Zerg_Egg || type == BWAPI::UnitTypes::Zerg_Larva || airRange(type, player) <= 0.0f)
             return 0.0f;
-        return unit.getPercentHealth() * unit.getMaxAirStrength();
+        else if (type == BWAPI::UnitTypes::Protoss_Interceptor)
+            return 2.0f;
+
+        const auto dps = airDPS(type, player);
+        const auto surv = log(survivability(type, player, speed(type, player)));
+        const auto range = log(airRange(type, player));
+        return dps * range * surv;
     }
 
-    float maxAirStrength(HorizonUnit& unit) {
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_Scarab || unit.getType() == BWAPI::UnitTypes::Terran_Vulture_Spider_Mine || unit.getType() == BWAPI::UnitTypes::Zerg_Egg || unit.getType() == BWAPI::UnitTypes::Zerg_Larva || unit.getAirRange() <= 0.0f)
+    float maxAirStrength(HorizonUnit& unit, float strength) {
+        if (strength <= 0.0f)
             return 0.0f;
-        else if (unit.getType() == BWAPI::UnitTypes::Protoss_Interceptor)
-            return 2.0f;
         else if (unit.getType() == BWAPI::UnitTypes::Protoss_Carrier) {
             float cnt = 0.0f;
-            for (auto &i : unit.unit()->getInterceptors()) {
-                if (i && !i->exists()) {
+            for (auto &i : Profile::call(unit.unit()->getInterceptors())) {
+                if (i && !Profile::call(i->exists())) {
                     cnt += 2.0f;
                 }
             }
             return cnt;
         }
-
-        const auto dps = airDPS(unit);
-        const auto surv = log(survivability(unit));
-        const auto eff = effectiveness(unit);
-        const auto range = log(unit.getAirRange());
-        return dps * range * surv * eff;
-    }
-
-    float speed(HorizonUnit& unit) {
-        float speed = float(unit.getType().topSpeed());
-
-        if ((unit.getType() == BWAPI::UnitTypes::Zerg_Zergling && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Metabolic_Boost)) || (unit.getType() == BWAPI::UnitTypes::Zerg_Hydralisk && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Muscular_Augments)) || (unit.getType() == BWAPI::UnitTypes::Zerg_Ultralisk && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Anabolic_Synthesis)) || (unit.getType() == BWAPI::UnitTypes::Protoss_Shuttle && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Gravitic_Drive)) || (unit.getType() == BWAPI::UnitTypes::Protoss_Observer && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Gravitic_Boosters)) || (unit.getType() == BWAPI::UnitTypes::Protoss_Zealot && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Leg_Enhancements)) || (unit.getType() == BWAPI::UnitTypes::Terran_Vulture && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Ion_Thrusters)))
-            return speed * 1.5f;
-        if (unit.getType() == BWAPI::UnitTypes::Zerg_Overlord && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Pneumatized_Carapace)) return speed * 4.01f;
-        if (unit.getType() == BWAPI::UnitTypes::Protoss_Scout && unit.getPlayer()->getUpgradeLevel(BWAPI::UpgradeTypes::Muscular_Augments)) return speed * 1.33f;
-        if (unit.getType().isBuilding()) return 0.0f;
-        return speed;
-    }
-
-    float percentHealth(HorizonUnit& unit) {
-        return float(unit.unit()->getHitPoints() + (unit.unit()->getShields() / 2)) / float(unit.getType().maxHitPoints() + (unit.getType().maxShields() / 2));
-    }
-
-    BWAPI::Position engagePosition(HorizonUnit& unit) {
-        if (!unit.hasTarget())
-            return BWAPI::Positions::None;        
-
-        int distance = (int)unit.getPosition().getDistance(unit.getTarget().getPosition());
-        int range = unit.getTarget().getType().isFlyer() ? (int)unit.getAirRange() : (int)unit.getGroundRange();
-        int leftover = distance - range;
-        BWAPI::Position direction = (unit.getPosition() - unit.getTarget().getPosition()) * leftover / distance;
-
-        if (distance > range)
-           return (unit.getPosition() - direction);
-        else
-           return (unit.getPosition());
+        else if (unit.getType() == BWAPI::UnitTypes::Protoss_Interceptor)
+            return strength;
+        return strength * effectiveness(unit);
     }
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Horizon {
+
+    /// Refers to an entry of a Pool, it stops resolving once the entry is released even if its slot is reused.
+    struct Handle {
+        int slot                = -1;
+        uint32_t generation     = 0;
+    };
+
+    /// Fixed number of entries kept in stable slots. Everything is allocated up front, so acquiring and releasing entries never touches the heap.
+    template <typename T>
+    class Pool {
+        std::vector<T> items;
+        std::vector<uint32_t> generations;
+        std::vector<int> freeSlots;
+        std::vector<int> live;                  // Slots in use, in no particular order
+        std::vector<int> liveIndex;             // Where each slot is in live, -1 if it's free
+
+    public:
+        explicit Pool(int capacity) : items(capacity), generations(capacity, 0), liveIndex(capacity, -1) {
+            freeSlots.reserve(capacity);
+            live.reserve(capacity);
+            for (int slot = capacity - 1; slot >= 0; slot--)
+                freeSlots.push_back(slot);
+        }
+
+        int capacity() const                    { return int(items.size()); }
+        const std::vector<int>& slots() const   { return live; }
+        T& operator[](int slot)                 { return items[slot]; }
+        const T& operator[](int slot) const     { return items[slot]; }
+        Handle handle(int slot) const           { return { slot, generations[slot] }; }
+
+        /// Returns the handle of an empty entry, or one that resolves to nothing if the pool is full.
+        Handle acquire() {
+            if (freeSlots.empty())
+                return Handle();
+
+            const auto slot = freeSlots.back();
+            freeSlots.pop_back();
+            liveIndex[slot] = int(live.size());
+            live.push_back(slot);
+            return handle(slot);
+        }
+
+        /// Resets the entry and moves to the next generation, so every handle to it goes stale.
+        void release(int slot) {
+            if (slot < 0 || slot >= capacity() || liveIndex[slot] < 0)
+                return;
+
+            items[slot] = T();
+            generations[slot]++;
+            live[liveIndex[slot]] = live.back();
+            liveIndex[live.back()] = liveIndex[slot];
+            live.pop_back();
+            liveIndex[slot] = -1;
+            freeSlots.push_back(slot);
+        }
+
+        T* get(const Handle& h) {
+            return h.slot >= 0 && h.slot < capacity() && generations[h.slot] == h.generation && liveIndex[h.slot] >= 0 ? &items[h.slot] : nullptr;
+        }
+    };
+
+    /// Maps ids to pool slots with open addressing. The table is sized for a fixed number of ids up front and is never more than half full, so it never allocates and probes stay short.
+    class IdTable {
+        struct Entry {
+            int id              = 0;
+            int slot            = -1;       // -1 if the entry is empty
+        };
+        std::vector<Entry> entries;
+        uint32_t mask           = 0;
+
+        uint32_t home(int id) const { return (uint32_t(id) * 2654435761u) & mask; }
+
+        uint32_t locate(int id) const {
+            auto i = home(id);
+            while (entries[i].slot >= 0 && entries[i].id != id)
+                i = (i + 1) & mask;
+            return i;
+        }
+
+    public:
+        explicit IdTable(int capacity) {
+            auto size = 1u;
+            while (size < uint32_t(capacity) * 2)
+                size <<= 1;
+            entries.resize(size);
+            mask = size - 1;
+        }
+
+        /// Returns the slot of the id, or -1 if it isn't in the table.
+        int find(int id) const {
+            return entries[locate(id)].slot;
+        }
+
+        void insert(int id, int slot) {
+            auto &entry = entries[locate(id)];
+            entry.id = id;
+            entry.slot = slot;
+        }
+
+        // Shifts later entries of the same probe run back into the hole, so lookups never need tombstones
+        void erase(int id) {
+            auto hole = locate(id);
+            if (entries[hole].slot < 0)
+                return;
+
+            for (auto i = (hole + 1) & mask; entries[i].slot >= 0; i = (i + 1) & mask) {
+                if (((i - home(entries[i].id)) & mask) >= ((i - hole) & mask)) {
+                    entries[hole] = entries[i];
+                    hole = i;
+                }
+            }
+            entries[hole] = Entry();
+        }
+    };
+}
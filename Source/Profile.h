@@ -0,0 +1,304 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Building with HORIZON_PROFILE defined times and counts the simulator's work, without it the macros below compile to nothing.
+// HORIZON_TALLY is for hot loops, it only adds to a plain per-thread tally that HORIZON_FLUSH reports in one go.
+#ifdef HORIZON_PROFILE
+#define HORIZON_TIMER(timer)            Horizon::Profile::ScopedTimer horizonScopedTimer(Horizon::Profile::Timer::timer)
+#define HORIZON_COUNT(counter, amount)  Horizon::Profile::get().add(Horizon::Profile::Counter::counter, amount)
+#define HORIZON_TALLY(counter, amount)  (Horizon::Profile::tally().counts[int(Horizon::Profile::Counter::counter)] += (amount))
+#define HORIZON_FLUSH()                 Horizon::Profile::get().flush()
+#define HORIZON_FRAME(frame)            Horizon::Profile::get().beginFrame(frame)
+#else
+#define HORIZON_TIMER(timer)
+#define HORIZON_COUNT(counter, amount)
+#define HORIZON_TALLY(counter, amount)
+#define HORIZON_FLUSH()
+#define HORIZON_FRAME(frame)
+#endif
+
+namespace Horizon::Profile {
+
+#ifdef HORIZON_PROFILE
+    constexpr bool Enabled = true;
+#else
+    constexpr bool Enabled = false;
+#endif
+
+    enum class Timer { AdapterUpdate, UpdateUnit, GetSimValue, GetSimCurve, GetSimValues, Simulate, SimEnemies, SimAllies, Count };
+    enum class Counter { Considered, Culled, Accumulated, BWAPICalls, Count };
+
+    constexpr int Timers = int(Timer::Count);
+    constexpr int Counters = int(Counter::Count);
+    constexpr const char* TimerNames[Timers] = { "adapterUpdate", "updateUnit", "getSimValue", "getSimCurve", "getSimValues", "simulate", "simEnemies", "simAllies" };
+    constexpr const char* CounterNames[Counters] = { "considered", "culled", "accumulated", "bwapiCalls" };
+
+    /// Everything timed and counted during one frame, times are in microseconds.
+    struct Frame {
+        int frame                   = 0;
+        double time[Timers]         = {};
+        int calls[Timers]           = {};
+        int64_t counts[Counters]    = {};
+
+        double getTime(Timer t) const           { return time[int(t)]; }
+        int getCalls(Timer t) const             { return calls[int(t)]; }
+        int64_t getCount(Counter c) const       { return counts[int(c)]; }
+    };
+
+    /// Latency of the most recent calls of a timer, in microseconds.
+    struct Latency {
+        float p50                   = 0.0f;
+        float p99                   = 0.0f;
+        float max                   = 0.0f;
+        int samples                 = 0;
+    };
+
+    /// Counts a thread added since it last flushed.
+    struct Tally {
+        int64_t counts[Counters]    = {};
+    };
+
+    inline Tally& tally() {
+        thread_local Tally threadTally;
+        return threadTally;
+    }
+
+    /// Collects timings and counters from every thread the simulator runs on, keeping a rolling window of each.
+    /// Threads add to totals of their own without locking, each frame is what they added between two calls to beginFrame.
+    class Profiler {
+    public:
+        static constexpr int HistoryFrames = 1024;
+        static constexpr int WindowSamples = 4096;
+
+    private:
+        // Only the owning thread writes the totals and samples, so it adds with a plain load and store, other threads only read them
+        struct Local {
+            std::atomic<int64_t> counts[Counters]       = {};
+            std::atomic<int64_t> nanoseconds[Timers]    = {};
+            std::atomic<int> calls[Timers]              = {};
+            std::atomic<float> samples[Timers][WindowSamples] = {};
+            std::atomic<int> written[Timers]            = {};   // Samples recorded so far, the window wraps around
+
+            // How much of the totals earlier frames took, only used while holding the profiler's mutex
+            int64_t reportedCounts[Counters]            = {};
+            int64_t reportedNanoseconds[Timers]         = {};
+            int reportedCalls[Timers]                   = {};
+            int firstSample[Timers]                     = {};   // Samples before a reset are ignored
+
+            void add(int c, int64_t amount) { counts[c].store(counts[c].load(std::memory_order_relaxed) + amount, std::memory_order_relaxed); }
+
+            void record(int t, float microseconds) {
+                nanoseconds[t].store(nanoseconds[t].load(std::memory_order_relaxed) + int64_t(microseconds * 1000.0f), std::memory_order_relaxed);
+                calls[t].store(calls[t].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                const auto n = written[t].load(std::memory_order_relaxed);
+                samples[t][n % WindowSamples].store(microseconds, std::memory_order_relaxed);
+                written[t].store(n + 1, std::memory_order_release);
+            }
+
+            // Adds what was added since the last report to the frame, and marks it reported if asked to
+            void collect(Frame& frame, bool report) {
+                for (int c = 0; c < Counters; c++) {
+                    const auto total = counts[c].load(std::memory_order_relaxed);
+                    frame.counts[c] += total - reportedCounts[c];
+                    reportedCounts[c] = report ? total : reportedCounts[c];
+                }
+                for (int t = 0; t < Timers; t++) {
+                    const auto total = nanoseconds[t].load(std::memory_order_relaxed);
+                    const auto count = calls[t].load(std::memory_order_relaxed);
+                    frame.time[t] += double(total - reportedNanoseconds[t]) / 1000.0;
+                    frame.calls[t] += count - reportedCalls[t];
+                    reportedNanoseconds[t] = report ? total : reportedNanoseconds[t];
+                    reportedCalls[t] = report ? count : reportedCalls[t];
+                }
+            }
+        };
+
+        mutable std::mutex mutex;                       // Guards the list of threads and the history, never taken to add
+        std::vector<std::shared_ptr<Local>> locals;     // One per thread that reported, dropped once the thread exits
+        int currentFrame            = 0;
+        bool started                = false;            // Nothing before the first frame is kept
+        std::vector<Frame> history;                     // Finished frames, oldest first once full
+        int nextFrame               = 0;
+
+        Local& local() {
+            thread_local std::shared_ptr<Local> mine;
+            if (!mine) {
+                mine = std::make_shared<Local>();
+                std::lock_guard<std::mutex> lock(mutex);
+                locals.push_back(mine);
+            }
+            return *mine;
+        }
+
+    public:
+        /// Finishes the current frame if this is a new one.
+        void beginFrame(int frame) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (started && frame == currentFrame)
+                return;
+
+            Frame finished;
+            finished.frame = currentFrame;
+            for (auto &l : locals)
+                l->collect(finished, true);
+
+            // Threads that exited have nothing left to add
+            locals.erase(std::remove_if(locals.begin(), locals.end(), [](auto &l) { return l.use_count() == 1; }), locals.end());
+
+            if (started) {
+                if (int(history.size()) < HistoryFrames)
+                    history.push_back(finished);
+                else
+                    history[nextFrame] = finished;
+                nextFrame = (nextFrame + 1) % HistoryFrames;
+            }
+            started = true;
+            currentFrame = frame;
+        }
+
+        void record(Timer timer, float microseconds)    { local().record(int(timer), microseconds); }
+        void add(Counter counter, int64_t amount)       { local().add(int(counter), amount); }
+
+        /// Adds this thread's tally to its totals and clears it.
+        void flush() {
+            auto &threadTally = tally();
+            auto &mine = local();
+            for (int c = 0; c < Counters; c++) {
+                if (threadTally.counts[c] != 0)
+                    mine.add(c, threadTally.counts[c]);
+                threadTally.counts[c] = 0;
+            }
+        }
+
+        /// Returns what has been timed and counted so far this frame.
+        Frame getFrame() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            Frame frame;
+            frame.frame = currentFrame;
+            for (auto &l : locals)
+                l->collect(frame, false);
+            return frame;
+        }
+
+        /// Returns the finished frames, oldest first.
+        std::vector<Frame> getHistory() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (int(history.size()) < HistoryFrames)
+                return history;
+
+            auto ordered = std::vector<Frame>(history.begin() + nextFrame, history.end());
+            ordered.insert(ordered.end(), history.begin(), history.begin() + nextFrame);
+            return ordered;
+        }
+
+        /// Latency of each thread's latest calls of a timer, taken together.
+        Latency getLatency(Timer timer) const {
+            const auto t = int(timer);
+            std::vector<float> sorted;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto &l : locals) {
+                    const auto n = l->written[t].load(std::memory_order_acquire);
+                    for (int i = std::max(l->firstSample[t], n - WindowSamples); i < n; i++)
+                        sorted.push_back(l->samples[t][i % WindowSamples].load(std::memory_order_relaxed));
+                }
+            }
+
+            Latency latency;
+            if (sorted.empty())
+                return latency;
+
+            std::sort(sorted.begin(), sorted.end());
+            const auto at = [&](float percentile) { return sorted[std::min(int(sorted.size()) - 1, int(percentile * float(sorted.size())))]; };
+            latency.p50 = at(0.50f);
+            latency.p99 = at(0.99f);
+            latency.max = sorted.back();
+            latency.samples = int(sorted.size());
+            return latency;
+        }
+
+        void reset() {
+            std::lock_guard<std::mutex> lock(mutex);
+            Frame discarded;
+            for (auto &l : locals) {
+                l->collect(discarded, true);
+                for (int t = 0; t < Timers; t++)
+                    l->firstSample[t] = l->written[t].load(std::memory_order_acquire);
+            }
+            started = false;
+            history.clear();
+            nextFrame = 0;
+        }
+
+        /// Writes a row per finished frame with the time and calls of each timer and every counter.
+        bool writeFramesCsv(const std::string& path) const {
+            std::ofstream file(path);
+            if (!file)
+                return false;
+
+            file << "frame";
+            for (auto name : TimerNames)
+                file << "," << name << "Us," << name << "Calls";
+            for (auto name : CounterNames)
+                file << "," << name;
+            file << "\n";
+
+            for (auto &frame : getHistory()) {
+                file << frame.frame;
+                for (int t = 0; t < Timers; t++)
+                    file << "," << frame.time[t] << "," << frame.calls[t];
+                for (int c = 0; c < Counters; c++)
+                    file << "," << frame.counts[c];
+                file << "\n";
+            }
+            return bool(file);
+        }
+
+        /// Writes a row per timer with the latency percentiles of its latest calls.
+        bool writeLatencyCsv(const std::string& path) const {
+            std::ofstream file(path);
+            if (!file)
+                return false;
+
+            file << "timer,p50Us,p99Us,maxUs,samples\n";
+            for (int t = 0; t < Timers; t++) {
+                const auto latency = getLatency(Timer(t));
+                file << TimerNames[t] << "," << latency.p50 << "," << latency.p99 << "," << latency.max << "," << latency.samples << "\n";
+            }
+            return bool(file);
+        }
+    };
+
+    /// The profiler every simulator in the process reports to.
+    inline Profiler& get() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    /// Passes through a value read from BWAPI and counts the call that read it. Calls that are short-circuited never run, so they aren't counted either.
+    template <typename T>
+    T call(T result) {
+        HORIZON_COUNT(BWAPICalls, 1);
+        return result;
+    }
+
+    /// Records how long the scope it lives in took.
+    class ScopedTimer {
+        Timer timer;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit ScopedTimer(Timer t) : timer(t), start(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer() {
+            get().record(timer, std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+    };
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+namespace Horizon {
+
+    /// Uniform grid that buckets the slots of a UnitStore by position, kept up to date as units move.
+    class SpatialHash {
+        int width = 1;
+        int height = 1;
+        std::vector<std::vector<int>> cells = std::vector<std::vector<int>>(1);
+        std::vector<int> cellOf;                // Cell of each slot, -1 if it isn't in the grid
+
+    public:
+        static constexpr int CellSize = 256;    // Pixels
+
+        /// Sizes the grid to cover a map of this many pixels, every slot has to be inserted again afterwards.
+        void resize(int pixelWidth, int pixelHeight) {
+            width = std::max(1, (pixelWidth + CellSize - 1) / CellSize);
+            height = std::max(1, (pixelHeight + CellSize - 1) / CellSize);
+            cells.assign(width * height, {});
+            cellOf.clear();
+        }
+
+        int getWidth() const                            { return width; }
+        int getHeight() const                           { return height; }
+        int cellX(float x) const                        { return std::clamp(int(x) / CellSize, 0, width - 1); }
+        int cellY(float y) const                        { return std::clamp(int(y) / CellSize, 0, height - 1); }
+        const std::vector<int>& getCell(int x, int y) const { return cells[y * width + x]; }
+
+        /// Adds the slot, or moves it if its position changed cells.
+        void insert(int slot, float x, float y) {
+            if (slot >= int(cellOf.size()))
+                cellOf.resize(slot + 1, -1);
+
+            const auto cell = cellY(y) * width + cellX(x);
+            if (cellOf[slot] == cell)
+                return;
+
+            remove(slot);
+            cells[cell].push_back(slot);
+            cellOf[slot] = cell;
+        }
+
+        void remove(int slot) {
+            if (slot >= int(cellOf.size()) || cellOf[slot] < 0)
+                return;
+
+            auto &cell = cells[cellOf[slot]];
+            auto itr = std::find(cell.begin(), cell.end(), slot);
+            *itr = cell.back();
+            cell.pop_back();
+            cellOf[slot] = -1;
+        }
+    };
+}
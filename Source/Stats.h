@@ -0,0 +1,79 @@
+#pragma once
+
+namespace Horizon::Stats {
+
+    /// Everything about a UnitType that only changes when its owner finishes an upgrade or research.
+    struct UnitStats {
+        float groundRange       = 0.0f;
+        float airRange          = 0.0f;
+        float groundDamage      = 0.0f;
+        float airDamage         = 0.0f;
+        float speed             = 0.0f;
+        float groundDPS         = 0.0f;
+        float airDPS            = 0.0f;
+        float groundStrength    = 0.0f;
+        float airStrength       = 0.0f;
+        int version             = 0;
+        bool built              = false;
+    };
+
+    namespace {
+        struct PlayerStats {
+            int frame = -1;
+            std::vector<int> research;
+            std::vector<UnitStats> types;
+        };
+
+        std::map<BWAPI::Player, PlayerStats> playerStats;
+        int statsBuilt = 0;
+
+        // Returns true if any upgrade level or researched tech differs from what the table was built with
+        bool updateResearch(BWAPI::Player player, std::vector<int>& research) {
+            auto changed = false;
+            auto i = 0u;
+            const auto check = [&](int value) {
+                if (i >= research.size())
+                    research.push_back(-1);
+                if (research[i] != value) {
+                    research[i] = value;
+                    changed = true;
+                }
+                i++;
+            };
+
+            for (auto &upgrade : BWAPI::UpgradeTypes::allUpgradeTypes())
+                check(Profile::call(player->getUpgradeLevel(upgrade)));
+            for (auto &tech : BWAPI::TechTypes::allTechTypes())
+                check(int(Profile::call(player->hasResearched(tech))));
+            return changed;
+        }
+    }
+
+    /// Returns the cached stats of this UnitType for this Player, rebuilding the Player's table only when their research changes.
+    const UnitStats& getStats(BWAPI::UnitType type, BWAPI::Player player) {
+        auto &table = playerStats[player];
+
+        // Research can only change once per frame, so only check it once per frame
+        if (const auto frame = Profile::call(BWAPI::Broodwar->getFrameCount()); table.frame != frame) {
+            table.frame = frame;
+            if (updateResearch(player, table.research) || table.types.empty())
+                table.types.assign(BWAPI::UnitTypes::Enum::MAX, UnitStats());
+        }
+
+        auto &stats = table.types[type.getID()];
+        if (!stats.built) {
+            stats.groundRange = Maths::groundRange(type, player);
+            stats.airRange = Maths::airRange(type, player);
+            stats.groundDamage = Maths::groundDamage(type, player);
+            stats.airDamage = Maths::airDamage(type, player);
+            stats.speed = Maths::speed(type, player);
+            stats.groundDPS = Maths::groundDPS(type, player);
+            stats.airDPS = Maths::airDPS(type, player);
+            stats.groundStrength = Maths::groundStrength(type, player);
+            stats.airStrength = Maths::airStrength(type, player);
+            stats.version = ++statsBuilt;
+            stats.built = true;
+        }
+        return stats;
+    }
+}
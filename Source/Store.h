@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+
+namespace Horizon {
+
+    /// Dense structure-of-arrays copy of every value the simulation reads from a unit.
+    /// Slots are handed out by whoever owns the store, and the arrays are always padded to a multiple of 8 so kernels can run over the whole store without a tail loop.
+    struct UnitStore {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> groundRange;
+        std::vector<float> airRange;
+        std::vector<float> speed;               // Pixels per second
+        std::vector<float> groundStrength;
+        std::vector<float> airStrength;
+        std::vector<float> width;
+        std::vector<float> height;              // Ground height of the unit's tile
+        std::vector<float> flyer;
+        std::vector<float> siege;
+        std::vector<float> active;              // 1.0 when the unit passes the simulation filter this frame
+        std::vector<float> hitPoints;           // Current hit points plus shields
+        std::vector<float> groundDPS;           // Damage per second
+        std::vector<float> airDPS;
+        std::vector<float> sizeClass;           // 0 small, 1 medium, 2 large
+
+        // Only used for our own units, these depend on the unit and its own target
+        std::vector<float> engageTime;          // Seconds to reach its engage position
+        std::vector<float> stranded;
+        std::vector<float> highGround;
+
+        int used = 0;
+
+        int size() const { return int(x.size()); }
+
+        /// Sizes the store to be filled with copy(), with 8 spare entries so kernels can read a full lane past any range.
+        void reset(int count) {
+            const auto padded = (count + 7) / 8 * 8 + 8;
+            for (auto arr : { &x, &y, &groundRange, &airRange, &speed, &groundStrength, &airStrength, &width, &height, &flyer, &siege, &active, &hitPoints, &groundDPS, &airDPS, &sizeClass, &engageTime, &stranded, &highGround })
+                arr->assign(padded, 0.0f);
+            used = count;
+        }
+
+        /// Copies a slot of another store into a slot of this one.
+        void copy(const UnitStore& from, int src, int dst) {
+            for (auto arr : { &UnitStore::x, &UnitStore::y, &UnitStore::groundRange, &UnitStore::airRange, &UnitStore::speed, &UnitStore::groundStrength, &UnitStore::airStrength, &UnitStore::width, &UnitStore::height, &UnitStore::flyer, &UnitStore::siege, &UnitStore::active, &UnitStore::hitPoints, &UnitStore::groundDPS, &UnitStore::airDPS, &UnitStore::sizeClass, &UnitStore::engageTime, &UnitStore::stranded, &UnitStore::highGround })
+                (this->*arr)[dst] = (from.*arr)[src];
+        }
+
+        /// Zeroes a slot whose unit was removed.
+        void clear(int slot) {
+            for (auto arr : { &x, &y, &groundRange, &airRange, &speed, &groundStrength, &airStrength, &width, &height, &flyer, &siege, &active, &hitPoints, &groundDPS, &airDPS, &sizeClass, &engageTime, &stranded, &highGround })
+                (*arr)[slot] = 0.0f;
+        }
+    };
+}
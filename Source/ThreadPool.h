@@ -0,0 +1,187 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Horizon {
+
+    /// Fixed set of worker threads that each own a queue of tasks and steal from the others once their own is empty.
+    class ThreadPool {
+        using Task = std::function<void()>;
+
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::thread> workers;
+        std::vector<std::unique_ptr<Queue>> queues;     // The last queue belongs to the thread that submits work
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::atomic<int> queued{ 0 };
+        std::atomic<int> remaining{ 0 };
+        bool stopping = false;
+
+        // Own queue from the front, everyone else's from the back
+        bool runOne(size_t self) {
+            Task task;
+            for (size_t i = 0; i < queues.size() && !task; i++) {
+                auto &queue = *queues[(self + i) % queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.tasks.empty())
+                    continue;
+                if (i == 0) {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                else {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                }
+            }
+            if (!task)
+                return false;
+
+            queued--;
+            task();
+            if (--remaining == 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+            return true;
+        }
+
+        void work(size_t self) {
+            while (true) {
+                if (runOne(self))
+                    continue;
+
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || queued > 0; });
+                if (stopping)
+                    return;
+            }
+        }
+
+    public:
+        explicit ThreadPool(int threads) {
+            const auto count = std::max(1, threads);
+            for (int i = 0; i < count; i++)
+                queues.push_back(std::make_unique<Queue>());
+            for (int i = 0; i < count - 1; i++)
+                workers.emplace_back([this, i] { work(size_t(i)); });
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto &w : workers)
+                w.join();
+        }
+
+        int size() const { return int(queues.size()); }
+
+        /// Splits [0, count) into chunks of at most grain, runs them across every thread including the caller and returns once all are finished.
+        void parallelFor(int count, int grain, const std::function<void(int, int)>& body) {
+            if (count <= 0)
+                return;
+
+            const auto chunks = (count + grain - 1) / grain;
+            remaining += chunks;
+            for (int c = 0; c < chunks; c++) {
+                const auto begin = c * grain;
+                const auto end = std::min(count, begin + grain);
+                auto &queue = *queues[c % queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.tasks.push_back([&body, begin, end] { body(begin, end); });
+                queued++;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                wake.notify_all();
+            }
+
+            // Help out until every chunk is finished
+            const auto self = queues.size() - 1;
+            while (remaining > 0) {
+                if (runOne(self))
+                    continue;
+
+                std::unique_lock<std::mutex> lock(mutex);
+                done.wait(lock, [&] { return remaining == 0 || queued > 0; });
+            }
+        }
+    };
+
+    /// One thread that runs a task at a time in the background and lives until it's destroyed, for work that outlasts the call that starts it.
+    class Worker {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::function<void()> task;
+        bool running = false;                   // From handing over a task until it finishes
+        bool stopping = false;
+        std::thread thread;                     // Last, so everything it uses exists before it starts
+
+        void work() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                wake.wait(lock, [&] { return stopping || task; });
+                if (stopping)
+                    return;
+
+                auto next = std::move(task);
+                task = nullptr;
+                lock.unlock();
+                next();
+                lock.lock();
+                running = false;
+                done.notify_all();
+            }
+        }
+
+    public:
+        Worker() : thread([this] { work(); }) {}
+
+        ~Worker() {
+            wait();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            thread.join();
+        }
+
+        /// True from when a task is handed over until it finishes.
+        bool busy() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return running;
+        }
+
+        /// Hands over the next task, only call this while the worker isn't busy.
+        void run(std::function<void()> next) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                task = std::move(next);
+                running = true;
+            }
+            wake.notify_one();
+        }
+
+        /// Returns once the current task, if any, is finished.
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&] { return !running; });
+        }
+    };
+}
@@ -0,0 +1,429 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Core.h"
+
+// A trace is every call that changed or queried a Simulator, in the order they were made, so a game can be replayed without Broodwar.
+// After a header, each event is a kind byte followed by its fields. Integers are zigzag varints, floats are raw little endian.
+// A unit update only stores the fields that changed since that unit's last update, integers as the difference, which keeps a long game
+// to a few bytes per unit per frame. Both ends stream the file, so traces of any length are read in constant memory.
+namespace Horizon::Trace {
+
+    constexpr char Magic[4] = { 'H', 'Z', 'T', 'R' };
+    constexpr uint32_t Version = 2;
+
+    enum class Kind : uint8_t { Map, Frame, Update, Remove, Exists, Query, Values, Curve, ClusterRadius, CacheTolerance, Schedule, DistanceBudget };
+
+    /// One recorded call. Only the fields that belong to its kind are filled in.
+    struct Event {
+        Kind kind               = Kind::Frame;
+        int frame               = 0;
+        int id                  = -1;
+        bool exists             = true;
+        UnitData unit;
+        TileGrid heights;
+        TileGrid walkable;
+        float simTime           = 0.0f;
+        Engine engine           = Engine::Linear;
+        HorizonOutput output;                               // What the recording returned, to diff a replay against
+        std::vector<std::pair<int, HorizonOutput>> outputs;
+        std::vector<float> simTimes;
+        std::vector<HorizonOutput> curve;
+        float clusterRadius     = 0.0f;
+        CacheTolerance cacheTolerance;
+        Schedule schedule;
+        int distanceBudget      = 0;
+    };
+
+    namespace {
+        constexpr int IntFields = 14;
+        constexpr int FloatFields = 7;
+        constexpr int FlagsBit = IntFields + FloatFields;
+
+        constexpr int UnitData::* Ints[IntFields] = { &UnitData::type, &UnitData::target, &UnitData::x, &UnitData::y, &UnitData::tileX, &UnitData::tileY, &UnitData::width,
+            &UnitData::tileWidth, &UnitData::tileHeight, &UnitData::hitPoints, &UnitData::shields, &UnitData::maxHitPoints, &UnitData::maxShields, &UnitData::size };
+        constexpr float UnitData::* Floats[FloatFields] = { &UnitData::groundRange, &UnitData::airRange, &UnitData::speed, &UnitData::maxGroundStrength,
+            &UnitData::maxAirStrength, &UnitData::groundDPS, &UnitData::airDPS };
+        constexpr bool UnitData::* Flags[] = { &UnitData::mine, &UnitData::exists, &UnitData::flyer, &UnitData::worker, &UnitData::building, &UnitData::siege,
+            &UnitData::stasised, &UnitData::morphing, &UnitData::completed, &UnitData::disabled };
+
+        uint32_t packFlags(const UnitData& unit) {
+            auto flags = 0u;
+            for (int i = 0; i < int(std::size(Flags)); i++)
+                flags |= (unit.*Flags[i] ? 1u : 0u) << i;
+            return flags;
+        }
+
+        void unpackFlags(UnitData& unit, uint32_t flags) {
+            for (int i = 0; i < int(std::size(Flags)); i++)
+                unit.*Flags[i] = (flags >> i) & 1u;
+        }
+    }
+
+    /// Appends events to a trace file.
+    class Writer {
+        std::ofstream file;
+        std::string buffer;                                 // The event being written, flushed to the file in one write
+        std::unordered_map<int, UnitData> units;            // Each unit as of its last recorded update
+
+        void byte(uint8_t value)    { buffer.push_back(char(value)); }
+
+        void varint(uint64_t value) {
+            for (; value >= 0x80; value >>= 7)
+                byte(uint8_t(value | 0x80));
+            byte(uint8_t(value));
+        }
+
+        void integer(int64_t value) { varint((uint64_t(value) << 1) ^ uint64_t(value >> 63)); }
+
+        void real(float value) {
+            char bytes[4];
+            std::memcpy(bytes, &value, 4);
+            buffer.append(bytes, 4);
+        }
+
+        void output(const HorizonOutput& o) {
+            real(o.attackAirAsAir);
+            real(o.attackAirAsGround);
+            real(o.attackGroundAsAir);
+            real(o.attackGroundasGround);
+            byte(o.shouldSynch);
+        }
+
+        void begin(Kind kind) {
+            buffer.clear();
+            byte(uint8_t(kind));
+        }
+
+        void end() { file.write(buffer.data(), std::streamsize(buffer.size())); }
+
+    public:
+        bool open(const std::string& path) {
+            units.clear();
+            file.open(path, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+
+            buffer.assign(Magic, 4);
+            for (int i = 0; i < 4; i++)
+                byte(uint8_t(Version >> (8 * i)));
+            end();
+            return bool(file);
+        }
+
+        bool isOpen() const { return file.is_open(); }
+
+        void close() {
+            if (file.is_open())
+                file.close();
+        }
+
+        void map(const TileGrid& heights, const TileGrid& walkable) {
+            begin(Kind::Map);
+            varint(uint64_t(heights.getWidth()));
+            varint(uint64_t(heights.getHeight()));
+            for (auto grid : { &heights, &walkable }) {
+                for (int y = 0; y < grid->getHeight(); y++)
+                    buffer.append(reinterpret_cast<const char*>(grid->row(y)), size_t(grid->getWidth()));
+            }
+            end();
+        }
+
+        void frame(int frame) {
+            begin(Kind::Frame);
+            integer(frame);
+            end();
+        }
+
+        void update(const UnitData& unit) {
+            auto itr = units.find(unit.id);
+            const auto added = itr == units.end();
+            if (added)
+                itr = units.emplace(unit.id, UnitData()).first;
+            auto &previous = itr->second;
+
+            auto mask = 0u;
+            for (int i = 0; i < IntFields; i++)
+                mask |= (unit.*Ints[i] != previous.*Ints[i]) ? 1u << i : 0u;
+            for (int i = 0; i < FloatFields; i++)
+                mask |= (unit.*Floats[i] != previous.*Floats[i]) ? 1u << (IntFields + i) : 0u;
+            mask |= (added || packFlags(unit) != packFlags(previous)) ? 1u << FlagsBit : 0u;
+
+            begin(Kind::Update);
+            integer(unit.id);
+            varint(mask);
+            for (int i = 0; i < IntFields; i++) {
+                if (mask & (1u << i))
+                    integer(int64_t(unit.*Ints[i]) - int64_t(previous.*Ints[i]));
+            }
+            for (int i = 0; i < FloatFields; i++) {
+                if (mask & (1u << (IntFields + i)))
+                    real(unit.*Floats[i]);
+            }
+            if (mask & (1u << FlagsBit))
+                varint(packFlags(unit));
+            end();
+            previous = unit;
+        }
+
+        void remove(int id) {
+            units.erase(id);
+            begin(Kind::Remove);
+            integer(id);
+            end();
+        }
+
+        // Only changes are recorded, the adapter marks every unit each time it simulates
+        void exists(int id, bool exists) {
+            auto itr = units.find(id);
+            if (itr == units.end() || itr->second.exists == exists)
+                return;
+
+            itr->second.exists = exists;
+            begin(Kind::Exists);
+            integer(id);
+            byte(exists);
+            end();
+        }
+
+        void query(int id, float simTime, Engine engine, const HorizonOutput& result) {
+            begin(Kind::Query);
+            integer(id);
+            real(simTime);
+            byte(uint8_t(engine));
+            output(result);
+            end();
+        }
+
+        void values(float simTime, Engine engine, const std::vector<std::pair<int, HorizonOutput>>& results) {
+            begin(Kind::Values);
+            real(simTime);
+            byte(uint8_t(engine));
+            varint(results.size());
+            for (auto &[id, result] : results) {
+                integer(id);
+                output(result);
+            }
+            end();
+        }
+
+        void curve(int id, const std::vector<float>& simTimes, const std::vector<HorizonOutput>& results) {
+            begin(Kind::Curve);
+            integer(id);
+            varint(simTimes.size());
+            for (auto simTime : simTimes)
+                real(simTime);
+            for (auto &result : results)
+                output(result);
+            end();
+        }
+
+        void clusterRadius(float radius) {
+            begin(Kind::ClusterRadius);
+            real(radius);
+            end();
+        }
+
+        void cacheTolerance(const CacheTolerance& tolerance) {
+            begin(Kind::CacheTolerance);
+            integer(tolerance.frames);
+            real(tolerance.distance);
+            real(tolerance.simTime);
+            real(tolerance.strength);
+            end();
+        }
+
+        void schedule(const Schedule& newSchedule) {
+            begin(Kind::Schedule);
+            integer(newSchedule.budget);
+            integer(newSchedule.idleFrames);
+            end();
+        }
+
+        void distanceBudget(int tilesPerFrame) {
+            begin(Kind::DistanceBudget);
+            integer(tilesPerFrame);
+            end();
+        }
+    };
+
+    /// Reads the events of a trace file in order.
+    class Reader {
+        std::ifstream file;
+        std::unordered_map<int, UnitData> units;
+        bool failed = false;
+
+        uint8_t byte() {
+            const auto c = file.get();
+            if (c == std::char_traits<char>::eof())
+                failed = true;
+            return uint8_t(c);
+        }
+
+        uint64_t varint() {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64 && !failed; shift += 7) {
+                const auto b = byte();
+                value |= uint64_t(b & 0x7f) << shift;
+                if (!(b & 0x80))
+                    break;
+            }
+            return value;
+        }
+
+        int64_t integer() {
+            const auto value = varint();
+            return int64_t(value >> 1) ^ -int64_t(value & 1);
+        }
+
+        float real() {
+            char bytes[4] = {};
+            if (!file.read(bytes, 4))
+                failed = true;
+            float value;
+            std::memcpy(&value, bytes, 4);
+            return value;
+        }
+
+        HorizonOutput output() {
+            HorizonOutput o;
+            o.attackAirAsAir = real();
+            o.attackAirAsGround = real();
+            o.attackGroundAsAir = real();
+            o.attackGroundasGround = real();
+            o.shouldSynch = byte() != 0;
+            return o;
+        }
+
+    public:
+        /// Opens a trace, returns false if it can't be read or was written by another version.
+        bool open(const std::string& path) {
+            units.clear();
+            failed = false;
+            file.open(path, std::ios::binary);
+
+            char magic[4] = {};
+            if (!file || !file.read(magic, 4) || std::memcmp(magic, Magic, 4) != 0)
+                return false;
+
+            auto version = 0u;
+            for (int i = 0; i < 4; i++)
+                version |= uint32_t(byte()) << (8 * i);
+            return !failed && version == Version;
+        }
+
+        /// True if the trace ended part way through an event.
+        bool truncated() const { return failed; }
+
+        /// Reads the next event, returns false at the end of the trace or if it's cut short.
+        bool next(Event& event) {
+            const auto kind = file.get();
+            if (kind == std::char_traits<char>::eof() || failed)
+                return false;
+
+            event.kind = Kind(kind);
+            switch (event.kind) {
+            case Kind::Map: {
+                const auto width = int(varint());
+                const auto height = int(varint());
+                for (auto grid : { &event.heights, &event.walkable }) {
+                    grid->resize(width, height);
+                    std::vector<char> row(size_t(std::max(0, width)));
+                    for (int y = 0; y < height && !failed; y++) {
+                        if (!file.read(row.data(), std::streamsize(row.size())))
+                            failed = true;
+                        for (int x = 0; x < width; x++)
+                            grid->set(x, y, uint8_t(row[x]));
+                    }
+                }
+                break;
+            }
+            case Kind::Frame:
+                event.frame = int(integer());
+                break;
+            case Kind::Update: {
+                const auto id = int(integer());
+                const auto mask = uint32_t(varint());
+                auto &unit = units[id];
+                unit.id = id;
+                for (int i = 0; i < IntFields; i++) {
+                    if (mask & (1u << i))
+                        unit.*Ints[i] = int(int64_t(unit.*Ints[i]) + integer());
+                }
+                for (int i = 0; i < FloatFields; i++) {
+                    if (mask & (1u << (IntFields + i)))
+                        unit.*Floats[i] = real();
+                }
+                if (mask & (1u << FlagsBit))
+                    unpackFlags(unit, uint32_t(varint()));
+                event.unit = unit;
+                break;
+            }
+            case Kind::Remove:
+                event.id = int(integer());
+                units.erase(event.id);
+                break;
+            case Kind::Exists:
+                event.id = int(integer());
+                event.exists = byte() != 0;
+                if (auto itr = units.find(event.id); itr != units.end())
+                    itr->second.exists = event.exists;
+                break;
+            case Kind::Query:
+                event.id = int(integer());
+                event.simTime = real();
+                event.engine = Engine(byte());
+                event.output = output();
+                break;
+            case Kind::Values: {
+                event.simTime = real();
+                event.engine = Engine(byte());
+                const auto count = varint();
+                event.outputs.clear();
+                for (uint64_t i = 0; i < count && !failed; i++) {
+                    const auto id = int(integer());
+                    event.outputs.emplace_back(id, output());
+                }
+                break;
+            }
+            case Kind::Curve: {
+                event.id = int(integer());
+                const auto count = varint();
+                event.simTimes.clear();
+                event.curve.clear();
+                for (uint64_t i = 0; i < count && !failed; i++)
+                    event.simTimes.push_back(real());
+                for (uint64_t i = 0; i < count && !failed; i++)
+                    event.curve.push_back(output());
+                break;
+            }
+            case Kind::ClusterRadius:
+                event.clusterRadius = real();
+                break;
+            case Kind::CacheTolerance:
+                event.cacheTolerance.frames = int(integer());
+                event.cacheTolerance.distance = real();
+                event.cacheTolerance.simTime = real();
+                event.cacheTolerance.strength = real();
+                break;
+            case Kind::Schedule:
+                event.schedule.budget = int(integer());
+                event.schedule.idleFrames = int(integer());
+                break;
+            case Kind::DistanceBudget:
+                event.distanceBudget = int(integer());
+                break;
+            default:
+                failed = true;
+            }
+            return !failed;
+        }
+    };
+}